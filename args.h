@@ -236,6 +236,9 @@ ArgDescriptor argDescriptors[] = {
   { "ruser", ArgString, (void *) &appData.remoteUser, FALSE, INVALID },
   { "timeDelay", ArgFloat, (void *) &appData.timeDelay, TRUE, INVALID },
   { "td", ArgFloat, (void *) &appData.timeDelay, FALSE, INVALID },
+  { "annotateDepth", ArgInt, (void *) &appData.annotateDepth, FALSE, (ArgIniType) 0 },
+  { "annotateShards", ArgInt, (void *) &appData.annotateShards, FALSE, (ArgIniType) 1 },
+  { "annotateShard", ArgInt, (void *) &appData.annotateShard, FALSE, (ArgIniType) 1 },
   { "timeControl", ArgString, (void *) &appData.timeControl, TRUE, (ArgIniType) TIME_CONTROL },
   { "tc", ArgString, (void *) &appData.timeControl, FALSE, INVALID },
   { "timeIncrement", ArgFloat, (void *) &appData.timeIncrement, FALSE, INVALID },
@@ -285,6 +288,8 @@ ArgDescriptor argDescriptors[] = {
   { "lpi", ArgInt, (void *) &appData.loadPositionIndex, FALSE, INVALID },
   { "savePositionFile", ArgFilename, (void *) &appData.savePositionFile, FALSE, (ArgIniType) "" },
   { "spf", ArgFilename, (void *) &appData.savePositionFile, FALSE, INVALID },
+  { "diagramFile", ArgFilename, (void *) &appData.diagramFile, FALSE, (ArgIniType) "" },
+  { "diagramJobs", ArgInt, (void *) &appData.diagramJobs, FALSE, (ArgIniType) 1 },
   { "matchMode", ArgBoolean, (void *) &appData.matchMode, FALSE, (ArgIniType) FALSE },
   { "mm", ArgTrue, (void *) &appData.matchMode, FALSE, INVALID },
   { "xmm", ArgFalse, (void *) &appData.matchMode, FALSE, INVALID },
@@ -747,12 +752,17 @@ ArgDescriptor argDescriptors[] = {
   { "zippyMaxGames", ArgInt, (void *)&appData.zippyMaxGames, FALSE, (ArgIniType) ZIPPY_MAX_GAMES},
   { "zippyReplayTimeout", ArgInt, (void *)&appData.zippyReplayTimeout, FALSE, (ArgIniType) ZIPPY_REPLAY_TIMEOUT },
   { "zippyShortGame", ArgInt, (void *)&appData.zippyShortGame, FALSE, INVALID },
+  { "zippyMaxPending", ArgInt, (void *)&appData.zippyMaxPending, FALSE, (ArgIniType) 0 },
   /* Kludge to allow winboard.ini files from buggy 4.0.4 to be read: */
   { "zippyReplyTimeout", ArgInt, (void *)&junk, FALSE, INVALID },
 #endif
   /* [HGM] options for broadcasting and time odds */
   { "chatBoxes", ArgString, (void *) &appData.chatBoxes, !XBOARD, (ArgIniType) NULL },
   { "serverMoves", ArgString, (void *) &appData.serverMovesName, FALSE, (ArgIniType) NULL },
+  { "icsRecord", ArgFilename, (void *) &appData.icsRecord, FALSE, (ArgIniType) "" },
+  { "icsReplay", ArgFilename, (void *) &appData.icsReplay, FALSE, (ArgIniType) "" },
+  { "icsReplaySpeed", ArgFloat, (void *) &appData.icsReplaySpeed, FALSE, INVALID },
+  { "relayFile", ArgFilename, (void *) &appData.relayFile, FALSE, (ArgIniType) "" },
   { "serverFile", ArgString, (void *) &appData.serverFileName, FALSE, (ArgIniType) NULL },
   { "suppressLoadMoves", ArgBoolean, (void *) &appData.suppressLoadMoves, FALSE, (ArgIniType) FALSE },
   { "serverPause", ArgInt, (void *) &appData.serverPause, FALSE, (ArgIniType) 15 },
@@ -1383,6 +1393,7 @@ InitAppData(char *lpCmdLine)
   // float: casting to int is not harmless, so default cannot be contained in table
   appData.timeDelay = TIME_DELAY;
   appData.timeIncrement = -314159;
+  appData.icsReplaySpeed = 1.0;
 
   // some complex, platform-dependent stuff that could not be handled from table
   SetDefaultTextAttribs();
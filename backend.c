@@ -68,6 +68,7 @@
 #else
 
 #   include <sys/file.h>
+#   include <sys/resource.h>
 #   define SLASH '/'
 
 #   include <dlfcn.h>
@@ -179,6 +180,7 @@ void HandleMachineMove P((char *message, ChessProgramState *cps));
 int AutoPlayOneMove P((void));
 int LoadGameOneMove P((ChessMove readAhead));
 int LoadGameFromFile P((char *filename, int n, char *title, int useList));
+int LoadShardGame P((char *filename));
 int LoadPositionFromFile P((char *filename, int n, char *title));
 int SavePositionToFile P((char *filename));
 void MakeMove P((int fromX, int fromY, int toX, int toY, int promoChar));
@@ -214,6 +216,9 @@ void SwitchClocks P((int nr));
 void StopClocks P((void));
 void ResetClocks P((void));
 char *PGNDate P((void));
+void RelayGameEnds P((int gamenum, char *endtoken));
+void RelayClear P((void));
+static void LoadReplaySchedule P((char *file, float speed));
 void SetGameInfo P((void));
 int RegisterMove P((void));
 void MakeRegisteredMove P((void));
@@ -234,6 +239,7 @@ void FeatureDone P((ChessProgramState* cps, int val));
 void InitChessProgram P((ChessProgramState *cps, int setup));
 void OutputKibitz(int window, char *text);
 int PerpetualChase(int first, int last);
+int PlyMateTest(int ply);
 int EngineOutputIsUp();
 void InitDrawingSizes(int x, int y);
 void NextMatchGame P((void));
@@ -475,6 +481,7 @@ ProcRef icsPR = NoProc, cmailPR = NoProc;
 InputSourceRef telnetISR = NULL, fromUserISR = NULL, cmailISR = NULL;
 GameMode gameMode = BeginningOfGame;
 char moveList[MAX_MOVES][MOVE_LEN], parseList[MAX_MOVES][MOVE_LEN * 2];
+static char sanPending[MAX_MOVES]; // [HGM] fast history: parseList[] of this ply still holds the server's move text
 char *commentList[MAX_MOVES], *cmailCommentList[CMAIL_MAX_GAMES];
 ChessProgramStats_Move pvInfoList[MAX_MOVES]; /* [AS] Info about engine thinking */
 int hiddenThinkOutputState = 0; /* [AS] */
@@ -1080,6 +1087,7 @@ void
 InitBackEnd1 ()
 {
 
+    InitMoveGenContext(&mainGen); // [HGM] gen: nothing entered or filtered yet
     ShowThinkingEvent(); // [HGM] thinking: make sure post/nopost state is set according to options
     startVariant = StringToVariant(appData.variant); // [HGM] nicks: remember original variant
 
@@ -1632,6 +1640,9 @@ InitBackEnd3 P((void))
 	    if (*appData.icsCommPort != NULLCHAR)
 	      len = snprintf(buf, MSG_SIZ, _("Could not open comm port %s"),
 			     appData.icsCommPort);
+	    else if (*appData.icsReplay != NULLCHAR)
+	      len = snprintf(buf, MSG_SIZ, _("Could not replay ICS session %s"),
+			     appData.icsReplay);
 	    else
 	      len = snprintf(buf, MSG_SIZ, _("Could not connect to host %s, port %s"),
 			appData.icsHost, appData.icsPort);
@@ -1719,6 +1730,9 @@ InitBackEnd3 P((void))
 	    return;
 	  }
 	}
+	if (initialMode == AnalyzeFile && appData.annotateShards > 1) {
+	    if(!LoadShardGame(appData.loadGameFile)) return;
+	} else
 	if (*appData.loadGameFile != NULLCHAR) {
 	    (void) LoadGameFromFile(appData.loadGameFile,
 				    appData.loadGameIndex,
@@ -1854,6 +1868,11 @@ establish ()
 	    return StartChildProcess(buf, "", &icsPR);
 
 	}
+    } else if (*appData.icsReplay != NULLCHAR) {
+	/* [HGM] replay: play back a recorded session in stead of connecting */
+	LoadReplaySchedule(appData.icsReplay, appData.icsReplaySpeed);
+	return OpenReplay(appData.icsReplay, appData.icsReplaySpeed, &icsPR);
+
     } else if (appData.useTelnet) {
 	return OpenTelnet(appData.icsHost, appData.icsPort, &icsPR);
 
@@ -2005,6 +2024,95 @@ ics_printf (char *format, ...)
     va_end(args);
 }
 
+/* [HGM] pace: text that must be sent to a process at a limited rate (such as the ICS logon script)
+   is queued, and trickled out from a timer, so that the GUI does not freeze while it drains.
+   Anything sent to the same process while its queue is not empty is queued behind it, to keep order.
+ */
+typedef struct PacedTextStruct {
+    struct PacedTextStruct *next;
+    int len, pos;
+    int telnet;         /* send through OutputMaybeTelnet */
+    long msdelay;       /* per character; 0 = all at once */
+    char text[1];
+} PacedText;
+
+typedef struct {
+    ProcRef pr;
+    PacedText *head, *tail;
+    TimeMark last;
+} PacedQueue;
+
+#define MAX_PACED 4
+static PacedQueue pacedQueue[MAX_PACED];
+
+static PacedQueue *
+FindPacedQueue (ProcRef pr, int create)
+{
+    int i;
+    for(i=0; i<MAX_PACED; i++) if(pacedQueue[i].head && pacedQueue[i].pr == pr) return &pacedQueue[i];
+    if(create) for(i=0; i<MAX_PACED; i++) if(!pacedQueue[i].head) {
+	pacedQueue[i].pr = pr;
+	GetTimeMark(&pacedQueue[i].last);
+	return &pacedQueue[i];
+    }
+    return NULL;
+}
+
+static void
+QueuePacedText (ProcRef pr, char *s, int count, long msdelay, int telnet)
+{
+    PacedQueue *q = FindPacedQueue(pr, TRUE);
+    PacedText *t;
+    if(q == NULL || (t = (PacedText *) malloc(sizeof(PacedText) + count)) == NULL) {
+	int outError; // no room: fall back on sending it unpaced
+	OutputToProcess(pr, s, count, &outError);
+	return;
+    }
+    memcpy(t->text, s, count);
+    t->len = count; t->pos = 0; t->telnet = telnet; t->msdelay = msdelay; t->next = NULL;
+    if(q->head) q->tail->next = t; else q->head = t;
+    q->tail = t;
+    if(!OutputTimerRunning()) DrainPacedOutput(); // first character goes out immediately
+}
+
+/* Called from the output timer: send whatever the rate limits allow by now, and rearm the timer */
+void
+DrainPacedOutput ()
+{
+    TimeMark now;
+    long next = -1, delay;
+    int i, n, outCount, outError;
+
+    GetTimeMark(&now);
+    for(i=0; i<MAX_PACED; i++) {
+	PacedQueue *q = &pacedQueue[i];
+	long elapsed = SubtractTimeMarks(&now, &q->last);
+	while(q->head) {
+	    PacedText *t = q->head;
+	    n = t->len - t->pos;
+	    if(t->msdelay > 0) { // as many characters as the time since the previous one allows, but at least one
+		if(elapsed/t->msdelay < n) n = elapsed/t->msdelay;
+		if(n < 1) n = 1;
+		elapsed = 0;
+	    }
+	    outCount = t->telnet ? OutputMaybeTelnet(q->pr, t->text + t->pos, n, &outError)
+				 : OutputToProcess(q->pr, t->text + t->pos, n, &outError);
+	    if(outCount < n) {
+		DisplayFatalError(_("Error writing to ICS"), outError, 1);
+		return;
+	    }
+	    delay = t->msdelay;
+	    if((t->pos += n) >= t->len) { q->head = t->next; free(t); }
+	    if(delay > 0) {
+		if(q->head && (next < 0 || delay < next)) next = delay;
+		break;
+	    }
+	}
+	q->last = now;
+    }
+    if(next >= 0) StartOutputTimer(next);
+}
+
 void
 SendToICS (char *s)
 {
@@ -2013,6 +2121,10 @@ SendToICS (char *s)
     if (icsPR == NoProc) return;
 
     count = strlen(s);
+    if (FindPacedQueue(icsPR, FALSE)) { // [HGM] pace: wait for turn behind logon script
+	QueuePacedText(icsPR, s, count, 0, TRUE);
+	return;
+    }
     outCount = OutputMaybeTelnet(icsPR, s, count, &outError);
     if (outCount < count) {
 	DisplayFatalError(_("Error writing to ICS"), outError, 1);
@@ -2025,7 +2137,7 @@ SendToICS (char *s)
 void
 SendToICSDelayed (char *s, long msdelay)
 {
-    int count, outCount, outError;
+    int count;
 
     if (icsPR == NoProc) return;
 
@@ -2035,11 +2147,7 @@ SendToICSDelayed (char *s, long msdelay)
 	show_bytes(debugFP, s, count);
 	fprintf(debugFP, "\n");
     }
-    outCount = OutputToProcessDelayed(icsPR, s, count, &outError,
-				      msdelay);
-    if (outCount < count) {
-	DisplayFatalError(_("Error writing to ICS"), outError, 1);
-    }
+    QueuePacedText(icsPR, s, count, msdelay, FALSE);
 }
 
 
@@ -2304,8 +2412,26 @@ StringToVariant (char *e)
 }
 
 static int leftover_start = 0, leftover_len = 0;
+static int scanEpoch = 1;
 char star_match[STAR_MATCH_N][MSG_SIZ];
 
+/* [HGM] scan: patterns that start with '*' are tried at every position of the ICS buffer,
+   and would each rescan the remainder of the line in search of the character that ends the
+   wildcard. As that end point cannot move back while the index advances, remember it for
+   every such anchor character, so that each byte is scanned at most once per anchor per read.
+   scanEpoch must be bumped whenever the buffer contents change.
+ */
+static int
+ScanForAnchor (char *buf, int from, unsigned char c)
+{
+    static int epoch[256], start[256], stop[256];
+    int i;
+    if(epoch[c] == scanEpoch && start[c] <= from && from <= stop[c]) return stop[c];
+    for(i = from; buf[i] != NULLCHAR && buf[i] != c && buf[i] != '\n' && buf[i] != '\r'; i++);
+    epoch[c] = scanEpoch; start[c] = from; stop[c] = i;
+    return i;
+}
+
 /* Test whether pattern is present at &buf[*index]; if so, return TRUE,
    advance *index beyond it, and set leftover_start to the new value of
    *index; else return FALSE.  If pattern contains the character '*', it
@@ -2320,6 +2446,16 @@ looking_at ( char *buf, int *index, char *pattern)
     int star_count = 0;
     char *matchp = star_match[0];
 
+    if (*patternp == '*' && patternp[1] != NULLCHAR) { // leading wildcard: jump to its anchor
+	int stop = ScanForAnchor(buf, *index, patternp[1]), n = stop - *index;
+	if (buf[stop] != patternp[1]) return FALSE; // line or buffer ended first
+	if (n >= MSG_SIZ) n = MSG_SIZ - 1;
+	strncpy(matchp, bufp, n); matchp[n] = NULLCHAR;
+	matchp = star_match[++star_count];
+	patternp += 2;
+	bufp = &buf[stop + 1];
+    }
+
     for (;;) {
 	if (*patternp == NULLCHAR) {
 	    *index = leftover_start = bufp - buf;
@@ -2601,22 +2737,104 @@ int suppressKibitz = 0;
 // [HGM] seekgraph
 Boolean soughtPending = FALSE;
 Boolean seekGraphUp;
-#define MAX_SEEK_ADS 200
 #define SQUARE 0x80
-char *seekAdList[MAX_SEEK_ADS];
-int ratingList[MAX_SEEK_ADS], xList[MAX_SEEK_ADS], yList[MAX_SEEK_ADS], seekNrList[MAX_SEEK_ADS], zList[MAX_SEEK_ADS];
-float tcList[MAX_SEEK_ADS];
-char colorList[MAX_SEEK_ADS];
+#define SEEK_HASH 256 /* buckets in the ad-number index (power of 2) */
+#define SEEK_CELL  16 /* pixel size of the cells used for hit testing */
+
+typedef struct {
+    char *text;     // compacted ad, as shown in the message field
+    int nr;         // ad number used by the ICS
+    int rating;     // -1 if seeker has no rating
+    float tc;       // base + 2/3 inc, plotted logarithmically
+    int color;      // dot color and shape, classified once when the ad arrives
+    int x, y;       // where the dot was last plotted
+    int z, age;     // click-priority penalty, and the aging step it is valid for
+    int nextNr;     // chain in the ad-number index
+    int cell;       // grid cell the dot was plotted in, -1 if not plotted
+    int nextCell;   // chain of dots in the same cell
+} SeekAd;
+
+static SeekAd *seekAds;
+static int seekAdsSize, seekAge;
+static int seekIndex[SEEK_HASH];
+static int *seekGrid, gridW, gridH, gridSize;
 int nrOfSeekAds = 0;
 int minRating = 1010, maxRating = 2800;
 int hMargin = 10, vMargin = 20, h, w;
 extern int squareSize, lineGap;
 
+void
+ClearSeekAds ()
+{   // forget all ads, so the graph can be refreshed from a new sought list
+    int i;
+    for(i=0; i<nrOfSeekAds; i++) free(seekAds[i].text);
+    for(i=0; i<SEEK_HASH; i++) seekIndex[i] = -1;
+    for(i=0; i<gridSize; i++) seekGrid[i] = -1;
+    nrOfSeekAds = 0;
+}
+
+static int
+SeekCell (int x, int y)
+{
+    x /= SEEK_CELL; y /= SEEK_CELL;
+    x = (x < 0 ? 0 : x >= gridW ? gridW - 1 : x);
+    y = (y < 0 ? 0 : y >= gridH ? gridH - 1 : y);
+    return y*gridW + x;
+}
+
+static void
+SeekCellRange (int lo, int hi, int n, int *first, int *last)
+{   // cells overlapping the pixel range lo..hi along an axis with n cells
+    *first = lo / SEEK_CELL; *last = hi / SEEK_CELL;
+    if(*first < 0) *first = 0;
+    if(*last >= n) *last = n - 1;
+}
+
+static void
+LinkSeekCell (int i)
+{
+    SeekAd *a = &seekAds[i];
+    if(!seekGrid) return;
+    a->cell = SeekCell(a->x, a->y);
+    a->nextCell = seekGrid[a->cell];
+    seekGrid[a->cell] = i;
+}
+
+static void
+UnlinkSeekAd (int i)
+{   // take ad out of the number index and the hit-test grid
+    int *p;
+    for(p = &seekIndex[seekAds[i].nr & (SEEK_HASH-1)]; *p != i; p = &seekAds[*p].nextNr);
+    *p = seekAds[i].nextNr;
+    if(seekAds[i].cell < 0) return;
+    for(p = &seekGrid[seekAds[i].cell]; *p != i; p = &seekAds[*p].nextCell);
+    *p = seekAds[i].nextCell;
+}
+
+static void
+RenumberSeekAd (int from, int to)
+{   // ad moved to other slot: redirect the links that pointed to it
+    int *p;
+    for(p = &seekIndex[seekAds[to].nr & (SEEK_HASH-1)]; *p != from; p = &seekAds[*p].nextNr);
+    *p = to;
+    if(seekAds[to].cell < 0) return;
+    for(p = &seekGrid[seekAds[to].cell]; *p != from; p = &seekAds[*p].nextCell);
+    *p = to;
+}
+
+static int
+SeekZ (SeekAd *a)
+{   // bring priority penalty up to date with the aging applied by clicks since it was set
+    while(a->age < seekAge && a->z > 0) a->z *= 0.8, a->age++;
+    a->age = seekAge;
+    return a->z;
+}
+
 void
 PlotSeekAd (int i)
 {
-	int x, y, color = 0, r = ratingList[i]; float tc = tcList[i];
-	xList[i] = yList[i] = -100; // outside graph, so cannot be clicked
+	SeekAd *a = &seekAds[i];
+	int x, y, r = a->rating; float tc = a->tc;
 	if(r < minRating+100 && r >=0 ) r = minRating+100;
 	if(r > maxRating) r = maxRating;
 	if(tc < 1.f) tc = 1.f;
@@ -2624,14 +2842,10 @@ PlotSeekAd (int i)
 	x = (w-hMargin-squareSize/8-7)* log(tc)/log(95.) + hMargin;
 	y = ((double)r - minRating)/(maxRating - minRating)
 	    * (h-vMargin-squareSize/8-1) + vMargin;
-	if(ratingList[i] < 0) y = vMargin + squareSize/4;
-	if(strstr(seekAdList[i], " u ")) color = 1;
-	if(!strstr(seekAdList[i], "lightning") && // for now all wilds same color
-	   !strstr(seekAdList[i], "bullet") &&
-	   !strstr(seekAdList[i], "blitz") &&
-	   !strstr(seekAdList[i], "standard") ) color = 2;
-	if(strstr(seekAdList[i], "(C) ")) color |= SQUARE; // plot computer seeks as squares
-	DrawSeekDot(xList[i]=x+3*(color&~SQUARE), yList[i]=h-1-y, colorList[i]=color);
+	if(a->rating < 0) y = vMargin + squareSize/4;
+	a->x = x + 3*(a->color & ~SQUARE); a->y = h-1-y;
+	LinkSeekCell(i);
+	DrawSeekDot(a->x, a->y, a->color);
 }
 
 void
@@ -2644,6 +2858,7 @@ void
 AddAd (char *handle, char *rating, int base, int inc,  char rated, char *type, int nr, Boolean plot)
 {
 	char buf[MSG_SIZ], *ext = "";
+	SeekAd *a;
 	VariantClass v = StringToVariant(type);
 	if(strstr(type, "wild")) {
 	    ext = type + 4; // append wild number
@@ -2652,48 +2867,63 @@ AddAd (char *handle, char *rating, int base, int inc,  char rated, char *type, i
 	    type = VariantName(v);
 	}
 	snprintf(buf, MSG_SIZ, "%s (%s) %d %d %c %s%s", handle, rating, base, inc, rated, type, ext);
-	if(nrOfSeekAds < MAX_SEEK_ADS-1) {
-	    if(seekAdList[nrOfSeekAds]) free(seekAdList[nrOfSeekAds]);
-	    ratingList[nrOfSeekAds] = -1; // for if seeker has no rating
-	    sscanf(rating, "%d", &ratingList[nrOfSeekAds]);
-	    tcList[nrOfSeekAds] = base + (2./3.)*inc;
-	    seekNrList[nrOfSeekAds] = nr;
-	    zList[nrOfSeekAds] = 0;
-	    seekAdList[nrOfSeekAds++] = StrSave(buf);
-	    if(plot) PlotSingleSeekAd(nrOfSeekAds-1);
-	}
+	if(nrOfSeekAds >= seekAdsSize) {
+	    if(!seekAdsSize) ClearSeekAds();
+	    seekAdsSize = 2*seekAdsSize + 64;
+	    seekAds = (SeekAd *) realloc(seekAds, seekAdsSize * sizeof(SeekAd));
+	}
+	a = &seekAds[nrOfSeekAds];
+	a->rating = -1; // for if seeker has no rating
+	sscanf(rating, "%d", &a->rating);
+	a->tc = base + (2./3.)*inc;
+	a->nr = nr;
+	a->z = 0; a->age = seekAge;
+	a->color = 0;
+	if(rated == 'u') a->color = 1;
+	if(!strstr(type, "lightning") && // for now all wilds same color
+	   !strstr(type, "bullet") &&
+	   !strstr(type, "blitz") &&
+	   !strstr(type, "standard") ) a->color = 2;
+	if(strstr(buf, "(C) ")) a->color |= SQUARE; // plot computer seeks as squares
+	a->text = StrSave(buf);
+	a->cell = -1; a->x = a->y = -100; // outside graph, so cannot be clicked
+	a->nextNr = seekIndex[nr & (SEEK_HASH-1)];
+	seekIndex[nr & (SEEK_HASH-1)] = nrOfSeekAds++;
+	if(plot) PlotSingleSeekAd(nrOfSeekAds-1);
 }
 
 void
 EraseSeekDot (int i)
 {
-    int x = xList[i], y = yList[i], d=squareSize/4, k;
+    int x = seekAds[i].x, y = seekAds[i].y, d=squareSize/4, k, cx, cy, x0, x1, y0, y1;
     DrawSeekBackground(x-squareSize/8, y-squareSize/8, x+squareSize/8+1, y+squareSize/8+1);
     if(x < hMargin+d) DrawSeekAxis(hMargin, y-squareSize/8, hMargin, y+squareSize/8+1);
-    // now replot every dot that overlapped
-    for(k=0; k<nrOfSeekAds; k++) if(k != i) {
-	int xx = xList[k], yy = yList[k];
+    // now replot every dot that overlapped; only nearby grid cells can hold those
+    if(!seekGrid) return;
+    SeekCellRange(x-d, x+d, gridW, &x0, &x1);
+    SeekCellRange(y-d, y+d, gridH, &y0, &y1);
+    for(cy=y0; cy<=y1; cy++) for(cx=x0; cx<=x1; cx++)
+      for(k=seekGrid[cy*gridW+cx]; k>=0; k=seekAds[k].nextCell) if(k != i) {
+	int xx = seekAds[k].x, yy = seekAds[k].y;
 	if(xx <= x+d && xx > x-d && yy <= y+d && yy > y-d)
-	    DrawSeekDot(xx, yy, colorList[k]);
+	    DrawSeekDot(xx, yy, seekAds[k].color);
     }
 }
 
 void
 RemoveSeekAd (int nr)
 {
-	int i;
-	for(i=0; i<nrOfSeekAds; i++) if(seekNrList[i] == nr) {
+	int i, last;
+	if(!nrOfSeekAds) return;
+	for(i = seekIndex[nr & (SEEK_HASH-1)]; i >= 0; i = seekAds[i].nextNr) if(seekAds[i].nr == nr) {
 	    EraseSeekDot(i);
-	    if(seekAdList[i]) free(seekAdList[i]);
-	    seekAdList[i] = seekAdList[--nrOfSeekAds];
-	    seekNrList[i] = seekNrList[nrOfSeekAds];
-	    ratingList[i] = ratingList[nrOfSeekAds];
-	    colorList[i]  = colorList[nrOfSeekAds];
-	    tcList[i] = tcList[nrOfSeekAds];
-	    xList[i]  = xList[nrOfSeekAds];
-	    yList[i]  = yList[nrOfSeekAds];
-	    zList[i]  = zList[nrOfSeekAds];
-	    seekAdList[nrOfSeekAds] = NULL;
+	    UnlinkSeekAd(i);
+	    free(seekAds[i].text);
+	    last = --nrOfSeekAds;
+	    if(i != last) { // fill the hole with the last ad
+		seekAds[i] = seekAds[last];
+		RenumberSeekAd(last, i);
+	    }
 	    break;
 	}
 }
@@ -2724,6 +2954,12 @@ DrawSeekGraph ()
     h = BOARD_HEIGHT * (squareSize + lineGap) + lineGap + 2*border;
     w = BOARD_WIDTH  * (squareSize + lineGap) + lineGap + 2*border;
 
+    // size the hit-test grid to the graph; all dots are re-entered when plotted below
+    gridW = w/SEEK_CELL + 1; gridH = h/SEEK_CELL + 1;
+    if(gridW*gridH > gridSize) seekGrid = (int *) realloc(seekGrid, (gridSize = gridW*gridH) * sizeof(int));
+    for(i=0; i<gridSize; i++) seekGrid[i] = -1;
+    for(i=0; i<nrOfSeekAds; i++) seekAds[i].cell = -1;
+
     DrawSeekBackground(0, 0, w, h);
     DrawSeekAxis(hMargin, h-1-vMargin, w-5, h-1-vMargin);
     DrawSeekAxis(hMargin, h-1-vMargin, hMargin, 5);
@@ -2765,39 +3001,47 @@ SeekGraphClick (ClickType click, int x, int y, int moving)
     }
     if(!seekGraphUp) { // initiate cration of seek graph by requesting seek-ad list
 	if(click == Release || moving) return FALSE;
-	nrOfSeekAds = 0;
+	ClearSeekAds();
 	soughtPending = TRUE;
 	SendToICS(ics_prefix);
 	SendToICS("sought\n"); // should this be "sought all"?
     } else { // issue challenge based on clicked ad
-	int dist = 10000; int i, closest = 0, second = 0;
-	for(i=0; i<nrOfSeekAds; i++) {
-	    int d = (x-xList[i])*(x-xList[i]) +  (y-yList[i])*(y-yList[i]) + zList[i];
+	int dist = 10000; int i, closest = 0, second = 0, cx, cy, x0, x1, y0, y1;
+	// only dots within reach of the click can be hit, so just scan the grid cells around it
+	if(seekGrid) {
+	    SeekCellRange(x-11, x+11, gridW, &x0, &x1);
+	    SeekCellRange(y-11, y+11, gridH, &y0, &y1);
+	} else x0 = y0 = 0, x1 = y1 = -1;
+	for(cy=y0; cy<=y1; cy++) for(cx=x0; cx<=x1; cx++)
+	  for(i=seekGrid[cy*gridW+cx]; i>=0; i=seekAds[i].nextCell) {
+	    int z = SeekZ(&seekAds[i]);
+	    int d = (x-seekAds[i].x)*(x-seekAds[i].x) +  (y-seekAds[i].y)*(y-seekAds[i].y) + z;
 	    if(d < dist) { dist = d; closest = i; }
-	    second += (d - zList[i] < 120); // count in-range ads
-	    if(click == Press && moving != 1 && zList[i]>0) zList[i] *= 0.8; // age priority
+	    second += (d - z < 120); // count in-range ads
 	}
+	if(click == Press && moving != 1) seekAge++; // age priority of all ads (applied lazily by SeekZ)
 	if(dist < 120) {
 	    char buf[MSG_SIZ];
 	    second = (second > 1);
 	    if(displayed != closest || second != lastSecond) {
-		DisplayMessage(second ? "!" : "", seekAdList[closest]);
+		DisplayMessage(second ? "!" : "", seekAds[closest].text);
 		lastSecond = second; displayed = closest;
 	    }
 	    if(click == Press) {
-		if(moving == 2) zList[closest] = 100; // right-click; push to back on press
+		if(moving == 2) seekAds[closest].z = 100, seekAds[closest].age = seekAge; // right-click; push to back on press
 		lastDown = closest;
 		return TRUE;
 	    } // on press 'hit', only show info
 	    if(moving == 2) return TRUE; // ignore right up-clicks on dot
-	    snprintf(buf, MSG_SIZ, "play %d\n", seekNrList[closest]);
+	    snprintf(buf, MSG_SIZ, "play %d\n", seekAds[closest].nr);
 	    SendToICS(ics_prefix);
 	    SendToICS(buf);
 	    return TRUE; // let incoming board of started game pop down the graph
 	} else if(click == Release) { // release 'miss' is ignored
-	    zList[lastDown] = 100; // make future selection of the rejected ad more difficult
+	    if(lastDown < nrOfSeekAds) // make future selection of the rejected ad more difficult
+		seekAds[lastDown].z = 100, seekAds[lastDown].age = seekAge;
 	    if(moving == 2) { // right up-click
-		nrOfSeekAds = 0; // refresh graph
+		ClearSeekAds(); // refresh graph
 		soughtPending = TRUE;
 		SendToICS(ics_prefix);
 		SendToICS("sought\n"); // should this be "sought all"?
@@ -2811,6 +3055,81 @@ SeekGraphClick (ClickType click, int x, int y, int moving)
     return TRUE;
 }
 
+/* [HGM] replay: with -icsRecord, every chunk read from the ICS is logged together with its arrival
+   time (in msec since the first one), so that the session can later be played back with -icsReplay.
+   During play-back we keep track of how long the parsing takes, for benchmarking. The time each chunk
+   arrives follows from the recording, as the child that plays it back paces it from the same start.
+ */
+static struct {
+    long bytes, chunks, parseTime, boards, boardTime, maxBoardTime;
+    long arrival;        // msec after start at which the oldest data of the current read arrived
+    long *due, *end;     // arrival time and end offset in the stream of every recorded chunk
+    int nrChunks, next;  // number of those, and first chunk not completely read yet
+    TimeMark start, chunkStart;
+} icsStats;
+
+static void
+LoadReplaySchedule (char *file, float speed)
+{   // read the time stamps of the recording, before the replay process starts sending it
+    FILE *f = fopen(file, "rb");
+    long stamp, pos = 0;
+    int count, size = 0;
+
+    while(f && fscanf(f, "%ld %d", &stamp, &count) == 2 && getc(f) == '\n' && count > 0 && fseek(f, count, SEEK_CUR) == 0) {
+	if(icsStats.nrChunks >= size) {
+	    size = 2*size + 1000;
+	    icsStats.due = (long *) realloc(icsStats.due, size * sizeof(long));
+	    icsStats.end = (long *) realloc(icsStats.end, size * sizeof(long));
+	}
+	icsStats.due[icsStats.nrChunks] = speed > 0 ? stamp/speed : 0;
+	icsStats.end[icsStats.nrChunks++] = pos += count;
+    }
+    if(f) fclose(f);
+    GetTimeMark(&icsStats.start); // the replay process paces the chunks from (just after) this
+}
+
+static void
+RecordICSInput (char *data, int count)
+{
+    static FILE *f;
+    static TimeMark start;
+    TimeMark now;
+
+    GetTimeMark(&now);
+    if(f == NULL) {
+	if((f = fopen(appData.icsRecord, "wb")) == NULL) return;
+	start = now;
+    }
+    fprintf(f, "%ld %d\n", SubtractTimeMarks(&now, &start), count);
+    fwrite(data, 1, count, f);
+    fflush(f);
+}
+
+static void
+ReportReplayStats ()
+{
+    TimeMark now;
+    long wall, rss = 0;
+    int n;
+    char buf[MSG_SIZ];
+#ifndef WIN32
+    struct rusage usage;
+    if(getrusage(RUSAGE_SELF, &usage) == 0) rss = usage.ru_maxrss;
+#endif
+    GetTimeMark(&now);
+    wall = SubtractTimeMarks(&now, &icsStats.start);
+    n = snprintf(buf, MSG_SIZ, "replay: %ld bytes in %ld chunks, %ld msec wall time, %ld msec parsing (%.0f KB/sec)\nreplay: %ld boards, ",
+		icsStats.bytes, icsStats.chunks, wall, icsStats.parseTime,
+		icsStats.bytes / 1.024 / (icsStats.parseTime ? icsStats.parseTime : 1), icsStats.boards);
+    if(appData.icsReplaySpeed > 0)
+	snprintf(buf + n, MSG_SIZ - n, "update latency %.2f msec average, %ld msec max; max RSS %ld KB\n",
+		icsStats.boardTime / (icsStats.boards ? (double) icsStats.boards : 1.), icsStats.maxBoardTime, rss);
+    else // everything is sent at once, so there is no arrival time to measure from
+	snprintf(buf + n, MSG_SIZ - n, "no update latency at speed 0; max RSS %ld KB\n", rss);
+    fputs(buf, stdout);
+    if(appData.debugMode) fputs(buf, debugFP);
+}
+
 void
 read_from_ics (InputSourceRef isr, VOIDSTAR closure, char *data, int count, int error)
 {
@@ -2845,6 +3164,15 @@ read_from_ics (InputSourceRef isr, VOIDSTAR closure, char *data, int count, int
 
     connectionAlive = TRUE; // [HGM] alive: I think, therefore I am...
 
+    if (count > 0 && *appData.icsRecord) RecordICSInput(data, count);
+    if (count > 0 && *appData.icsReplay) { // [HGM] replay: boards completed by this read can be as old as its first byte
+	GetTimeMark(&icsStats.chunkStart);
+	while (icsStats.next < icsStats.nrChunks && icsStats.end[icsStats.next] <= icsStats.bytes) icsStats.next++;
+	icsStats.arrival = icsStats.next < icsStats.nrChunks ? icsStats.due[icsStats.next] : SubtractTimeMarks(&icsStats.chunkStart, &icsStats.start);
+	icsStats.chunks++;
+	icsStats.bytes += count;
+    }
+
     if (appData.debugMode) {
       if (!error) {
 	fprintf(debugFP, "<ICS: ");
@@ -2928,6 +3256,7 @@ read_from_ics (InputSourceRef isr, VOIDSTAR closure, char *data, int count, int
     }
 
 	buf[buf_len] = NULLCHAR;
+	scanEpoch++; // [HGM] scan: invalidate anchor positions remembered for the old contents
 //	next_out = leftover_len; // [HGM] should we set this to 0, and not print it in advance?
 	next_out = 0;
 	leftover_start = 0;
@@ -4053,6 +4382,7 @@ read_from_ics (InputSourceRef isr, VOIDSTAR closure, char *data, int count, int
 		}
 
 		/* Game end messages */
+		if (*appData.relayFile) RelayGameEnds(gamenum, endtoken);
 		if (gameMode == IcsIdle || gameMode == BeginningOfGame ||
 		    ics_gamenum != gamenum) {
 		    continue;
@@ -4087,6 +4417,7 @@ read_from_ics (InputSourceRef isr, VOIDSTAR closure, char *data, int count, int
 		       for the next challenge. */
 		    gameInfo.variant = VariantNormal; // [HGM] variantswitch: suppress sending of 'variant'
 		    Reset(TRUE, TRUE);
+		    ZippyEngineReady(); // [HGM] pending: next challenge, if engine needs no time to finish
 		}
 #endif /*ZIPPY*/
 		if(appData.bgObserve && partnerBoardValid) DrawPosition(TRUE, partnerBoard);
@@ -4096,6 +4427,7 @@ read_from_ics (InputSourceRef isr, VOIDSTAR closure, char *data, int count, int
 	    if (looking_at(buf, &i, "Removing game * from observation") ||
 		looking_at(buf, &i, "no longer observing game *") ||
 		looking_at(buf, &i, "Game * (*) has no examiners")) {
+		if (*appData.relayFile) RelayGameEnds(atoi(star_match[0]), "*");
 		if (gameMode == IcsObserving &&
 		    atoi(star_match[0]) == ics_gamenum)
 		  {
@@ -4140,6 +4472,15 @@ read_from_ics (InputSourceRef isr, VOIDSTAR closure, char *data, int count, int
 		    parse[parse_pos] = NULLCHAR;
 		    ParseBoard12(parse);
 		    ics_user_moved = 0;
+		    if (*appData.icsReplay) { // [HGM] replay: time from arrival of the data to updated board
+			TimeMark now;
+			long t;
+			GetTimeMark(&now);
+			t = SubtractTimeMarks(&now, &icsStats.start) - icsStats.arrival;
+			if (t < 0) t = 0; // the replay process started marginally later than our clock
+			icsStats.boards++; icsStats.boardTime += t;
+			if (t > icsStats.maxBoardTime) icsStats.maxBoardTime = t;
+		    }
 
 		    /* Send premove here */
 		    if (appData.premove) {
@@ -4279,10 +4620,23 @@ read_from_ics (InputSourceRef isr, VOIDSTAR closure, char *data, int count, int
 	/* if buffer ends with something we couldn't parse,
 	   reparse it after appending the next read */
 
+	if (*appData.icsReplay) {
+	    TimeMark now;
+	    GetTimeMark(&now);
+	    icsStats.parseTime += SubtractTimeMarks(&now, &icsStats.chunkStart);
+	}
+
     } else if (count == 0) {
 	RemoveInputSource(isr);
+	RelayClear();
+	if (*appData.icsReplay) { // end of recording
+	    ReportReplayStats();
+	    ExitEvent(0);
+	    return;
+	}
         DisplayFatalError(_("Connection closed by ICS"), 0, 0);
     } else {
+	RelayClear();
 	DisplayFatalError(_("Error reading from ICS"), error, 1);
     }
 }
@@ -4308,6 +4662,193 @@ read_from_ics (InputSourceRef isr, VOIDSTAR closure, char *data, int count, int
 #define RELATION_ISOLATED_BOARD     -3
 #define RELATION_STARTING_POSITION  -4   /* FICS only */
 
+/* [HGM] relay: record every observed ICS game in the background, each in its own PGN file.
+ * Games are kept in a hash table on game number, so that a style-12 board can be routed to
+ * its game without search. New moves are appended to the PGN file, over the game termination
+ * written after the previous ones; only when moves are taken back the file is written anew.
+ */
+#define RELAY_HASH 64
+#define PGN_MAX_LINE 75
+
+typedef struct RelayGameStruct {
+    struct RelayGameStruct *next;
+    int gamenum;
+    int firstPly, lastPly;  /* moves known for plies firstPly .. lastPly-1 */
+    int size;
+    char (*san)[MOVE_LEN];
+    long *clock;            /* time left for the mover after each move, in msec */
+    char white[MSG_SIZ], black[MSG_SIZ];
+    char fen[MSG_SIZ];      /* position at firstPly */
+    char *date;
+    int written, linelen;   /* moves in the file (up to ply 'written'), and length of its last line */
+    long resultPos, tail;   /* file offsets of the Result tag and of the termination, 0 if no file yet */
+} RelayGame;
+
+static RelayGame *relayHash[RELAY_HASH];
+
+static RelayGame *
+RelayFind (int gamenum, int create)
+{
+    RelayGame **p = &relayHash[gamenum & (RELAY_HASH-1)], *g;
+    for(g = *p; g; g = g->next) if(g->gamenum == gamenum) return g;
+    if(!create || !(g = (RelayGame *) calloc(1, sizeof(RelayGame)))) return NULL;
+    g->gamenum = gamenum; g->lastPly = -1;
+    g->next = *p; *p = g;
+    return g;
+}
+
+static void
+RelayFileName (char *name, int gamenum)
+{   // substitute the game number for the first %d; the option is not trusted as printf format
+    char *p = appData.relayFile, *q = name, *end = name + MSG_SIZ - 16;
+    int done = FALSE;
+    while(*p && q < end) {
+	if(*p == '%' && p[1] == 'd' && !done) q += sprintf(q, "%d", gamenum), p += 2, done = TRUE; else
+	if(*p == '%' && p[1] == '%') *q++ = '%', p += 2; else
+	*q++ = *p++;
+    }
+    if(!done) q += sprintf(q, "%d", gamenum); // no place for it: append, so games do not overwrite each other
+    *q = NULLCHAR;
+}
+
+static void
+RelayMoves (FILE *f, RelayGame *g, char *result)
+{   // write the moves that are not in the file yet, followed by the game termination
+    char buf[MSG_SIZ];
+    int i, len;
+
+    for(i = g->written; i < g->lastPly; i++) {
+	long c = g->clock[i - g->firstPly] / 1000;
+	len = 0;
+	if(!(i & 1)) len = snprintf(buf, MSG_SIZ, "%d. ", i/2 + 1); else
+	if(i == g->firstPly) len = snprintf(buf, MSG_SIZ, "%d... ", i/2 + 1);
+	len += snprintf(buf + len, MSG_SIZ - len, "%s {[%%clk %ld:%02ld:%02ld]}",
+			g->san[i - g->firstPly], c/3600, c/60 % 60, c % 60);
+	if(g->linelen && g->linelen + len >= PGN_MAX_LINE) fprintf(f, "\n"), g->linelen = 0;
+	fprintf(f, "%s%s", g->linelen ? " " : "", buf);
+	g->linelen += len + (g->linelen > 0);
+    }
+    g->written = g->lastPly;
+    g->tail = ftell(f); // the next moves will overwrite the termination
+    fprintf(f, "%s%s\n\n", g->linelen ? " " : "", result);
+}
+
+static void
+RelayWrite (RelayGame *g, char *result)
+{   // write the complete PGN file
+    char name[MSG_SIZ];
+    FILE *f;
+
+    g->tail = 0;
+    RelayFileName(name, g->gamenum);
+    if((f = fopen(name, "w")) == NULL) return;
+    fprintf(f, "[Event \"ICS game %d\"]\n[Site \"%s\"]\n[Date \"%s\"]\n[Round \"-\"]\n",
+		g->gamenum, appData.icsHost, g->date);
+    fprintf(f, "[White \"%s\"]\n[Black \"%s\"]\n", g->white, g->black);
+    g->resultPos = ftell(f); // padded, so that the final result can later be written over it
+    fprintf(f, "[Result \"%s\"]%*s\n", result, 7 - (int) strlen(result), "");
+    if(g->firstPly > 0 || strncmp(g->fen, "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR ", 44))
+	fprintf(f, "[SetUp \"1\"]\n[FEN \"%s\"]\n", g->fen);
+    fprintf(f, "\n");
+    g->written = g->firstPly; g->linelen = 0;
+    RelayMoves(f, g, result);
+    fclose(f);
+}
+
+static void
+RelayUpdate (RelayGame *g, char *result)
+{   // add the new moves to the PGN file, and the result if it is known
+    char name[MSG_SIZ];
+    FILE *f;
+
+    RelayFileName(name, g->gamenum);
+    if(!g->tail || g->written > g->lastPly || (f = fopen(name, "r+")) == NULL) { // no file yet, or moves taken back
+	RelayWrite(g, result);
+	return;
+    }
+    fseek(f, g->tail, SEEK_SET); // the new text is never shorter than the termination it replaces
+    RelayMoves(f, g, result);
+    if(strcmp(result, "*")) fseek(f, g->resultPos, SEEK_SET), fprintf(f, "[Result \"%s\"]", result);
+    fclose(f);
+}
+
+static void
+RelayBoard12 (int gamenum, char *white, char *black, int ply, char *move, long whiteTime, long blackTime, char *fen)
+{
+    RelayGame *g = RelayFind(gamenum, TRUE);
+    if(g == NULL) return;
+    if(g->lastPly < 0 || ply < g->firstPly || ply > g->lastPly + 1 || strcmp(white, g->white)) {
+	// first board of this game, or we missed something: record from this position on
+	safeStrCpy(g->white, white, MSG_SIZ);
+	safeStrCpy(g->black, black, MSG_SIZ);
+	safeStrCpy(g->fen, fen, MSG_SIZ);
+	free(g->date); g->date = PGNDate();
+	g->firstPly = g->lastPly = ply;
+	g->tail = 0; // start a new file
+    } else if(ply == g->lastPly + 1) {
+	int n = ply - 1 - g->firstPly;
+	char *p;
+	if(n >= g->size) { // make room
+	    g->size = 2*g->size + 64;
+	    g->san = realloc(g->san, g->size * sizeof(*g->san));
+	    g->clock = realloc(g->clock, g->size * sizeof(*g->clock));
+	}
+	safeStrCpy(g->san[n], move, MOVE_LEN);
+	if(!strncmp(move, "o-o", 3)) for(p = g->san[n]; *p; p++) if(*p == 'o') *p = 'O'; // ICS castling to PGN
+	g->clock[n] = ply & 1 ? whiteTime : blackTime;
+	g->lastPly = ply;
+    } else g->lastPly = ply; // taken back (or repeated board)
+    RelayUpdate(g, "*");
+}
+
+void
+RelayGameEnds (int gamenum, char *endtoken)
+{   // write final version of the PGN, and forget the game
+    RelayGame **p = &relayHash[gamenum & (RELAY_HASH-1)], *g;
+    char result[8];
+    for(; (g = *p); p = &g->next) if(g->gamenum == gamenum) break;
+    if(g == NULL) return;
+    while(*endtoken == ' ') endtoken++;
+    snprintf(result, 8, "%s", *endtoken == '1' || *endtoken == '0' ? endtoken : "*");
+    RelayUpdate(g, result);
+    *p = g->next;
+    free(g->san); free(g->clock); free(g->date); free(g);
+}
+
+void
+RelayClear ()
+{   // forget all games, e.g. because we stopped observing, or lost the connection; their PGN stays unfinished
+    RelayGame *g;
+    int i;
+    for(i=0; i<RELAY_HASH; i++) while((g = relayHash[i])) {
+	relayHash[i] = g->next;
+	free(g->san); free(g->clock); free(g->date); free(g);
+    }
+}
+
+static char *
+Style12ToFEN (char *boardChars, char toPlay, int doublePush, int ws, int wl, int bs, int bl, int irrev, int ply)
+{   // the style-12 board is already in FEN order; only squeeze runs of empty squares into counts
+    static char fen[MSG_SIZ];
+    char *p = fen, *q = boardChars;
+    int empty = 0;
+    for(;; q++) {
+	if(*q == '-') { empty++; continue; }
+	if(empty) p += sprintf(p, "%d", empty), empty = 0;
+	if(*q == NULLCHAR) break;
+	*p++ = *q == ' ' ? '/' : *q;
+    }
+    p += sprintf(p, " %c ", ToLower(toPlay));
+    if(ws) *p++ = 'K';
+    if(wl) *p++ = 'Q';
+    if(bs) *p++ = 'k';
+    if(bl) *p++ = 'q';
+    if(!(ws | wl | bs | bl)) *p++ = '-';
+    if(doublePush >= 0) sprintf(p, " %c%c %d %d", 'a' + doublePush, toPlay == 'W' ? '6' : '3', irrev, ply/2 + 1);
+    else sprintf(p, " - %d %d", irrev, ply/2 + 1);
+    return fen;
+}
+
 void
 ParseBoard12 (char *string)
 {
@@ -4374,6 +4915,15 @@ ParseBoard12 (char *string)
       return;
     }
 
+    if(*appData.relayFile && ics_getting_history == H_FALSE && (relation == RELATION_OBSERVING_PLAYED ||
+       relation == RELATION_PLAYING_MYMOVE || relation == RELATION_PLAYING_NOTMYMOVE)) {
+	int fac = strchr(elapsed_time, '.') ? 1 : 1000;
+	RelayBoard12(gamenum, white, black, moveNum, move_str, white_time*fac, black_time*fac,
+		     Style12ToFEN(board_chars, to_play, double_push, castle_ws, castle_wl, castle_bs, castle_bl, irrev_count, moveNum));
+	if(gameMode == IcsObserving && gamenum != ics_gamenum && relation == RELATION_OBSERVING_PLAYED)
+	    return; // [HGM] relay: other observed games are only recorded, keep displaying the current one
+    }
+
     switch (relation) {
       case RELATION_OBSERVING_PLAYED:
       case RELATION_OBSERVING_STATIC:
@@ -4804,6 +5354,7 @@ ParseBoard12 (char *string)
     /* Put the move on the move list, first converting
        to canonical algebraic form. */
     if (moveNum > 0) {
+	sanPending[moveNum - 1] = FALSE;
   if (appData.debugMode) {
     int f = forwardMostMove;
     fprintf(debugFP, "parseboard %d, castling = %d %d %d %d %d %d\n", f,
@@ -5108,6 +5659,7 @@ SendMoveToProgram (int moveNum, ChessProgramState *cps)
     }
     if (cps->useSAN) {
       char *space;
+      VerifyHistory(moveNum, moveNum + 1);
       if ((space = strchr(parseList[moveNum], ' ')) != NULL) {
 	int len = space - parseList[moveNum];
 	memcpy(buf, parseList[moveNum], len);
@@ -5313,6 +5865,7 @@ UploadGameEvent ()
       if(bsetup || ics_type != ICS_ICC && gameInfo.variant != VariantNormal)
 	    SendToICS("bsetup done\n"); // switch to normal examining.
     }
+    VerifyHistory(backwardMostMove, last);
     for(i = backwardMostMove; i<last; i++) {
 	char buf[20];
 	snprintf(buf, sizeof(buf)/sizeof(buf[0]),"%s\n", parseList[i]);
@@ -5327,9 +5880,6 @@ UploadGameEvent ()
     SendToICS(ics_type == ICS_ICC ? "tag result Game in progress\n" : "commit\n");
 }
 
-int killX = -1, killY = -1; // [HGM] lion: used for passing e.p. capture square to MakeMove
-int legNr = 1;
-
 void
 CoordsToComputerAlgebraic (int rf, int ff, int rt, int ft, char promoChar, char move[7])
 {
@@ -5341,7 +5891,7 @@ CoordsToComputerAlgebraic (int rf, int ff, int rt, int ft, char promoChar, char
 	if (promoChar == 'x' || promoChar == NULLCHAR) {
 	  sprintf(move, "%c%c%c%c\n",
                     AAA + ff, ONE + rf, AAA + ft, ONE + rt);
-	  if(killX >= 0 && killY >= 0) sprintf(move+4, ";%c%c\n", AAA + killX, ONE + killY);
+	  if(mainGen.killFile >= 0 && mainGen.killRank >= 0) sprintf(move+4, ";%c%c\n", AAA + mainGen.killFile, ONE + mainGen.killRank);
 	} else {
 	    sprintf(move, "%c%c%c%c%c\n",
                     AAA + ff, ONE + rf, AAA + ft, ONE + rt, promoChar);
@@ -5536,7 +6086,7 @@ ParseOneMove (char *move, int moveNum, ChessMove *moveType, int *fromX, int *fro
 	if (appData.testLegality) {
 	  return (*moveType != IllegalMove);
 	} else {
-	  return !(*fromX == *toX && *fromY == *toY && killX < 0) && boards[moveNum][*fromY][*fromX] != EmptySquare &&
+	  return !(*fromX == *toX && *fromY == *toY && mainGen.killFile < 0) && boards[moveNum][*fromY][*fromX] != EmptySquare &&
 			 // [HGM] lion: if this is a double move we are less critical
 			WhiteOnMove(moveNum) == (boards[moveNum][*fromY][*fromX] < BlackPawn);
 	}
@@ -6208,6 +6758,7 @@ InitPosition (int redraw)
     if(gameInfo.holdingsSize) gameInfo.holdingsWidth = 2;
     if(BOARD_HEIGHT > BOARD_RANKS || BOARD_WIDTH > BOARD_FILES)
         DisplayFatalError(_("Recompile to support this BOARD_RANKS or BOARD_FILES!"), 0, 2);
+    else MakeRays(); // [HGM] speed: the move generators assume these fit the board
 
     pawnRow = gameInfo.boardHeight - 7; /* seems to work in all common variants */
     if(pawnRow < 1) pawnRow = 1;
@@ -7264,10 +7815,10 @@ Mark (Board board, int flags, ChessMove kind, int rf, int ff, int rt, int ft, VO
 {
     typedef char Markers[BOARD_RANKS][BOARD_FILES];
     Markers *m = (Markers *) closure;
-    if(rf == fromY && ff == fromX && (killX < 0 ? !(rt == rf && ft == ff) && legNr & 1 : rt == killY && ft == killX || legNr & 2))
+    if(rf == fromY && ff == fromX && (mainGen.killFile < 0 ? !(rt == rf && ft == ff) && mainGen.legs & 1 : rt == mainGen.killRank && ft == mainGen.killFile || mainGen.legs & 2))
 	(*m)[rt][ft] = 1 + (board[rt][ft] != EmptySquare
 			 || kind == WhiteCapturesEnPassant
-			 || kind == BlackCapturesEnPassant) + 3*(kind == FirstLeg && killX < 0), legal[rt][ft] = 1;
+			 || kind == BlackCapturesEnPassant) + 3*(kind == FirstLeg && mainGen.killFile < 0), legal[rt][ft] = 1;
     else if(flags & F_MANDATORY_CAPTURE && board[rt][ft] != EmptySquare) (*m)[rt][ft] = 3, legal[rt][ft] = 1;
 }
 
@@ -7460,7 +8011,7 @@ LeftClick (ClickType clickType, int xPix, int yPix)
       if(gameMode == AnalyzeMode && (pausing || controlKey) && first.excludeMoves) { // use pause state to exclude moves
 	doubleClick = TRUE; gatingPiece = boards[currentMove][y][x];
       }
-      fromX = x; fromY = y; toX = toY = killX = killY = -1;
+      fromX = x; fromY = y; toX = toY = mainGen.killFile = mainGen.killRank = -1;
       if(!appData.oneClick || !OnlyMove(&x, &y, FALSE) ||
 	 // even if only move, we treat as normal when this would trigger a promotion popup, to allow sweep selection
 	 appData.sweepSelect && CanPromote(boards[currentMove][fromY][fromX], fromY) && originalY != y) {
@@ -7500,7 +8051,7 @@ LeftClick (ClickType clickType, int xPix, int yPix)
 	fromP = boards[currentMove][fromY][fromX];
 	toP = boards[currentMove][y][x];
 	frc = appData.fischerCastling || gameInfo.variant == VariantSChess;
- 	if( (killX < 0 || x != fromX || y != fromY) && // [HGM] lion: do not interpret igui as deselect!
+ 	if( (mainGen.killFile < 0 || x != fromX || y != fromY) && // [HGM] lion: do not interpret igui as deselect!
 	   ((WhitePawn <= fromP && fromP <= WhiteKing &&
 	     WhitePawn <= toP && toP <= WhiteKing &&
 	     !(fromP == WhiteKing && toP == WhiteRook && frc) &&
@@ -7511,7 +8062,7 @@ LeftClick (ClickType clickType, int xPix, int yPix)
 	     !(fromP == BlackKing && toP == BlackRook && frc)))) {
 	    /* Clicked again on same color piece -- changed his mind */
 	    second = (x == fromX && y == fromY);
-	    killX = killY = -1;
+	    mainGen.killFile = mainGen.killRank = -1;
 	    if(second && gameMode == AnalyzeMode && SubtractTimeMarks(&lastClickTime, &prevClickTime) < 200) {
 		second = FALSE; // first double-click rather than scond click
 		doubleClick = first.excludeMoves; // used by UserMoveEvent to recognize exclude moves
@@ -7549,7 +8100,7 @@ LeftClick (ClickType clickType, int xPix, int yPix)
 	if(x < BOARD_LEFT || x >= BOARD_RGHT) return;
     }
 
-    if (clickType == Release && x == fromX && y == fromY && killX < 0) {
+    if (clickType == Release && x == fromX && y == fromY && mainGen.killFile < 0) {
 	DragPieceEnd(xPix, yPix); dragging = 0;
 	if(clearFlag) {
 	    // a deferred attempt to click-click move an empty square on top of a piece
@@ -7583,7 +8134,7 @@ LeftClick (ClickType clickType, int xPix, int yPix)
     clearFlag = 0;
 
     if(gameMode != EditPosition && !appData.testLegality && !legal[y][x] &&
-       fromX >= BOARD_LEFT && fromX < BOARD_RGHT && (x != killX || y != killY) && !sweepSelecting) {
+       fromX >= BOARD_LEFT && fromX < BOARD_RGHT && (x != mainGen.killFile || y != mainGen.killRank) && !sweepSelecting) {
 	if(dragging) DragPieceEnd(xPix, yPix), dragging = 0;
 	DisplayMessage(_("only marked squares are legal"),"");
 	DrawPosition(TRUE, NULL);
@@ -7611,8 +8162,8 @@ LeftClick (ClickType clickType, int xPix, int yPix)
 	if(dragging == 2) {  // [HGM] lion: just turn buttonless drag into normal drag, and let release to the job
 	    return;
 	}
-	if(x == killX && y == killY) {              // second click on this square, which was selected as first-leg target
-	    killX = killY = -1;                     // this informs us no second leg is coming, so treat as to-click without intermediate
+	if(x == mainGen.killFile && y == mainGen.killRank) {              // second click on this square, which was selected as first-leg target
+	    mainGen.killFile = mainGen.killRank = -1;                     // this informs us no second leg is coming, so treat as to-click without intermediate
 	} else
 	if(marker[y][x] == 5) return; // [HGM] lion: to-click on cyan square; defer action to release
 	if(legal[y][x] == 2 || HasPromotionChoice(fromX, fromY, toX, toY, &promoChoice, FALSE)) {
@@ -7654,8 +8205,8 @@ LeftClick (ClickType clickType, int xPix, int yPix)
 	if(marker[y][x] == 5) { // [HGM] lion: this was the release of a to-click or drag on a cyan square
 	  dragging *= 2;            // flag button-less dragging if we are dragging
 	  MarkTargetSquares(1);
-	  if(x == killX && y == killY) killX = killY = -1; else {
-	    killX = x; killY = y;     //remeber this square as intermediate
+	  if(x == mainGen.killFile && y == mainGen.killRank) mainGen.killFile = mainGen.killRank = -1; else {
+	    mainGen.killFile = x; mainGen.killRank = y;     //remeber this square as intermediate
 	    ReportClick("put", x, y); // and inform engine
 	    ReportClick("lift", x, y);
 	    MarkTargetSquares(0);
@@ -8237,9 +8788,9 @@ Adjudicate (ChessProgramState *cps)
 				// [HGM] xiangqi: check for forbidden perpetuals
 				int m, ourPerpetual = 1, hisPerpetual = 1;
 				for(m=forwardMostMove; m>k; m-=2) {
-				    if(MateTest(boards[m], PosFlags(m)) != MT_CHECK)
+				    if(PlyMateTest(m) != MT_CHECK)
 					ourPerpetual = 0; // the current mover did not always check
-				    if(MateTest(boards[m-1], PosFlags(m-1)) != MT_CHECK)
+				    if(PlyMateTest(m-1) != MT_CHECK)
 					hisPerpetual = 0; // the opponent did not always check
 				}
 				if(appData.debugMode) fprintf(debugFP, "XQ perpetual test, our=%d, his=%d\n",
@@ -8299,7 +8850,7 @@ Adjudicate (ChessProgramState *cps)
 			if(i < backwardMostMove) i = backwardMostMove;
 			while(i <= forwardMostMove) {
 				lastCheck = inCheck; // check evasion does not count
-				inCheck = (MateTest(boards[i], PosFlags(i)) == MT_CHECK);
+				inCheck = (PlyMateTest(i) == MT_CHECK);
 				if(inCheck || lastCheck) count--; // check does not count
 				i++;
 			}
@@ -8637,7 +9188,7 @@ FakeBookMove: // [HGM] book: we jump here to simulate machine moves after book h
         if(cps->alphaRank) AlphaRank(machineMove, 4);
 
 	// [HGM] lion: (some very limited) support for Alien protocol
-	killX = killY = -1;
+	mainGen.killFile = mainGen.killRank = -1;
 	if(machineMove[strlen(machineMove)-1] == ',') { // move ends in coma: non-final leg of composite move
 	    safeStrCpy(firstLeg, machineMove, 20); // just remember it for processing when second leg arrives
 	    return;
@@ -8649,7 +9200,7 @@ FakeBookMove: // [HGM] book: we jump here to simulate machine moves after book h
 	    safeStrCpy(machineMove, firstLeg, 20);
 	    while(isdigit(*p)) p++;
 	    safeStrCpy(p, q, 20); // glue to-square of second leg to from-square of first, to process over-all move
-	    sscanf(buf, "%c%d", &f, &killY); killX = f - AAA; killY -= ONE - '0'; // pass intermediate square to MakeMove in global
+	    sscanf(buf, "%c%d", &f, &mainGen.killRank); mainGen.killFile = f - AAA; mainGen.killRank -= ONE - '0'; // pass intermediate square to MakeMove in global
 	    firstLeg[0] = NULLCHAR;
 	}
 
@@ -8660,7 +9211,7 @@ FakeBookMove: // [HGM] book: we jump here to simulate machine moves after book h
 		    machineMove, _(cps->which));
 	    DisplayMoveError(buf1);
             snprintf(buf1, MSG_SIZ*10, "Xboard: Forfeit due to invalid move: %s (%c%c%c%c via %c%c) res=%d",
-                    machineMove, fromX+AAA, fromY+ONE, toX+AAA, toY+ONE, killX+AAA, killY+ONE, moveType);
+                    machineMove, fromX+AAA, fromY+ONE, toX+AAA, toY+ONE, mainGen.killFile+AAA, mainGen.killRank+ONE, moveType);
 	    if (gameMode == TwoMachinesPlay) {
 	      GameEnds(machineWhite ? BlackWins : WhiteWins,
                        buf1, GE_XBOARD);
@@ -8812,7 +9363,7 @@ FakeBookMove: // [HGM] book: we jump here to simulate machine moves after book h
 	    cps->other->maybeThinking = TRUE;
 	}
 
-	roar = (killX >= 0 && IS_LION(boards[forwardMostMove][toY][toX]));
+	roar = (mainGen.killFile >= 0 && IS_LION(boards[forwardMostMove][toY][toX]));
 
 	ShowMove(fromX, fromY, toX, toY); /*updates currentMove*/
 
@@ -8912,8 +9463,8 @@ FakeBookMove: // [HGM] book: we jump here to simulate machine moves after book h
                                                && gameInfo.variant != VariantFairy    ) return;
       if(piece < EmptySquare) {
         pieceDefs = TRUE;
-        ASSIGN(pieceDesc[piece], buf1);
-        if(isupper(*p) && p[1] == '&') { ASSIGN(pieceDesc[WHITE_TO_BLACK piece], buf1); }
+        ASSIGN(pieceDesc[piece], buf1); CompilePieceDesc(piece);
+        if(isupper(*p) && p[1] == '&') { ASSIGN(pieceDesc[WHITE_TO_BLACK piece], buf1); CompilePieceDesc(WHITE_TO_BLACK piece); }
       }
       return;
     }
@@ -9033,6 +9584,9 @@ FakeBookMove: // [HGM] book: we jump here to simulate machine moves after book h
 	    }
 	    initPing = -1;
         }
+#if ZIPPY
+	if (appData.zippyPlay && cps == &first && appData.icsActive) ZippyEngineReady(); // [HGM] pending
+#endif
 	return;
     }
     if(!strncmp(message, "highlight ", 10)) {
@@ -9537,6 +10091,9 @@ FakeBookMove: // [HGM] book: we jump here to simulate machine moves after book h
 		    if(tempStats.score != 0 || tempStats.nodes != 0 || tempStats.time != 0)
 			programStats = tempStats; // [HGM] info: only set stats if genuine PV and not an info line
 
+		if(gameMode == AnalyzeFile && appData.annotateDepth > 0 && programStats.depth >= appData.annotateDepth
+		   && StopLoadGameTimer()) StartLoadGameTimer(1); // [HGM] shard: requested depth reached, step to next move
+
                 SendProgramStatsToFrontend( cps, &tempStats );
 
                 /*
@@ -9697,6 +10254,160 @@ FakeBookMove: // [HGM] book: we jump here to simulate machine moves after book h
 }
 
 
+/* [HGM] fast history: in orthodox chess the SAN of a move list sent by the ICS can be decoded by
+   a simple scan of the board, without the legality and disambiguation tests of the general lexer.
+   The move is still verified when its SAN is generated for display; tokens the scan cannot
+   decide, or that fail that verification, are left to the general parser. */
+
+static int
+FastHistoryVariant ()
+{
+    switch(gameInfo.variant) {
+      case VariantNormal:
+      case VariantLosers:
+      case VariantSuicide:
+      case VariantGiveaway:
+	return BOARD_WIDTH == 8 && BOARD_HEIGHT == 8 && BOARD_LEFT == 0 && gameInfo.holdingsWidth == 0;
+      default:
+	return FALSE;
+    }
+}
+
+static int
+FastReach (Board board, int fromX, int fromY, int toX, int toY, char piece)
+{
+    int dx = toX - fromX, dy = toY - fromY, sx, sy;
+    switch(piece) {
+      case 'N': return dx*dx + dy*dy == 5;
+      case 'K': return dx*dx <= 1 && dy*dy <= 1;
+      case 'B': if(dx*dx != dy*dy) return FALSE; break;
+      case 'R': if(dx && dy) return FALSE; break;
+      case 'Q': if(dx && dy && dx*dx != dy*dy) return FALSE; break;
+    }
+    sx = (dx > 0) - (dx < 0); sy = (dy > 0) - (dy < 0);
+    for(fromX += sx, fromY += sy; fromX != toX || fromY != toY; fromX += sx, fromY += sy)
+	if(board[fromY][fromX] != EmptySquare) return FALSE;
+    return TRUE;
+}
+
+static int
+FastHistoryMove (Board board, int white, char *san)
+{   // decode SAN into currentMoveString; FALSE if not uniquely decodable by piece geometry alone
+    static char letters[] = "NBRQK";
+    static ChessSquare pieces[] = { WhiteKnight, WhiteBishop, WhiteRook, WhiteQueen, WhiteKing };
+    int len = strlen(san), fromX = -1, fromY = -1, toX, toY, x, y, n = 0, dir = white ? 1 : -1;
+    int shift = white ? 0 : BlackPawn - WhitePawn, back = white ? 0 : 7;
+    char promo = NULLCHAR, piece = 'P', *p;
+    ChessSquare moved, victim;
+
+    while(len > 0 && strchr("+#!?", san[len-1])) len--;
+    if(len == 3 && !strncmp(san, "O-O", 3) || len == 5 && !strncmp(san, "O-O-O", 5)) {
+	if(board[back][4] != (ChessSquare) (WhiteKing + shift)) return FALSE;
+	snprintf(currentMoveString, 5, "%c%c%c%c", AAA+4, ONE+back, AAA+(len == 3 ? 6 : 2), ONE+back);
+	return TRUE;
+    }
+    if(len >= 4 && san[len-2] == '=') promo = san[len-1], len -= 2;
+    if(len < 2 || san[len-2] < AAA || san[len-2] > AAA+7 || san[len-1] < ONE || san[len-1] > ONE+7) return FALSE;
+    toX = san[len-2] - AAA; toY = san[len-1] - ONE;
+    if(*san && (p = strchr(letters, *san))) piece = *san++, len--;
+    for(len -= 2; len > 0; len--, san++) {
+	if(*san >= AAA && *san <= AAA+7) fromX = *san - AAA; else
+	if(*san >= ONE && *san <= ONE+7) fromY = *san - ONE; else
+	if(*san != 'x' && *san != ':' && *san != '-') return FALSE;
+    }
+    victim = board[toY][toX];
+    if(victim != EmptySquare && (victim < BlackPawn) == white) return FALSE; // own piece on target
+    if(piece == 'P') {
+	moved = (ChessSquare) (WhitePawn + shift);
+	if((toY == back + 7*dir) != (promo != NULLCHAR) || promo && !strchr(letters, promo)) return FALSE;
+	if(fromX < 0 || fromX == toX) { // push
+	    fromX = toX;
+	    if(victim != EmptySquare) return FALSE;
+	    if(board[toY-dir][toX] == moved) fromY = toY - dir; else
+	    if(board[toY-dir][toX] == EmptySquare && toY == back + 3*dir && board[toY-2*dir][toX] == moved) fromY = toY - 2*dir;
+	    else return FALSE;
+	} else { // capture, possibly e.p.
+	    if(fromX - toX != 1 && toX - fromX != 1 || board[toY-dir][fromX] != moved) return FALSE;
+	    fromY = toY - dir;
+	}
+    } else {
+	if(promo) return FALSE;
+	moved = (ChessSquare) (pieces[p - letters] + shift);
+	for(y=0; y<8; y++) for(x=0; x<8; x++)
+	    if(board[y][x] == moved && (fromX < 0 || x == fromX) && (fromY < 0 || y == fromY) && FastReach(board, x, y, toX, toY, piece)) {
+		if(n++) return FALSE; // ambiguous on geometry (pin): needs the legality test
+		fromX = x; fromY = y;
+	    }
+	if(!n) return FALSE;
+    }
+    snprintf(currentMoveString, 6, "%c%c%c%c%c", AAA+fromX, ONE+fromY, AAA+toX, ONE+toY, ToLower(promo));
+    return TRUE;
+}
+
+static int
+FastHistoryToken (char **game, int boardIndex, ChessMove *moveType)
+{   // classify next token of the move list; FALSE when the general parser must take over at *game
+    static char token[MSG_SIZ];
+    char *p = *game, *q;
+    int len;
+
+    while(*p == ' ' || *p == '\t' || *p == '\r' || *p == '\n') p++;
+    *game = p;
+    if(*p == NULLCHAR) { *moveType = EndOfFile; return TRUE; }
+    for(q = p; *q && *q != ' ' && *q != '\t' && *q != '\r' && *q != '\n'; q++);
+    if((len = q - p) >= MSG_SIZ) return FALSE;
+    strncpy(token, p, len); token[len] = NULLCHAR;
+    yy_text = token;
+    if(len == strspn(token, "-") || len == strspn(token, "0123456789.") && token[len-1] == '.')
+	*moveType = Comment; // move number or table ruling
+    else if(token[0] == '(' && token[len-1] == ')' && strchr(token, ':') && len-2 == strspn(token+1, "0123456789:."))
+	*moveType = ElapsedTime;
+    else if(FastHistoryMove(boards[boardIndex], WhiteOnMove(boardIndex), token))
+	*moveType = NormalMove;
+    else return FALSE;
+    *game = q;
+    return TRUE;
+}
+
+/* [HGM] fast history: the scanner decodes a move from piece geometry alone, which for a legal
+   move is exact. So only the text of the moves has to be made, and that is postponed until it
+   is needed: every reader of a range of parseList[] first calls VerifyHistory() on it.
+   */
+void
+VerifyHistory (int first, int last)
+{   // make SAN and check marks of fast-scanned moves in this range, and test their legality
+    int i;
+    ChessMove moveType;
+    char san[MOVE_LEN*2], buf[MOVE_LEN*2], *time;
+
+    if(first < backwardMostMove) first = backwardMostMove;
+    if(last > forwardMostMove) last = forwardMostMove;
+    for(i = first; i < last; i++) {
+	if(!sanPending[i]) continue;
+	sanPending[i] = FALSE;
+	time = strchr(parseList[i], ' '); // elapsed time appended to the move
+	moveType = CoordsToAlgebraic(boards[i], PosFlags(i), moveList[i][1] - ONE, moveList[i][0] - AAA,
+				     moveList[i][3] - ONE, moveList[i][2] - AAA,
+				     moveList[i][4] == '\n' ? NULLCHAR : moveList[i][4], san);
+	if(moveType == IllegalMove || moveType == ImpossibleMove) {
+	    if (appData.debugMode) fprintf(debugFP, "Illegal move from ICS: '%s'\n", parseList[i]);
+	    continue; // keep what the server sent
+	}
+	switch (MateTest(boards[i+1], PosFlags(i+1))) {
+	  case MT_CHECK:
+	    strcat(san, "+");
+	    break;
+	  case MT_CHECKMATE:
+	  case MT_STAINMATE:
+	    strcat(san, "#");
+	  default:
+	    break;
+	}
+	snprintf(buf, MOVE_LEN*2, "%s%s", san, time ? time : "");
+	safeStrCpy(parseList[i], buf, sizeof(parseList[i])/sizeof(parseList[i][0]));
+    }
+}
+
 /* Parse a game score from the character string "game", and
    record it as the history of the current game.  The game
    score is NOT assumed to start from the standard position.
@@ -9706,7 +10417,7 @@ void
 ParseGameHistory (char *game)
 {
     ChessMove moveType;
-    int fromX, fromY, toX, toY, boardIndex;
+    int fromX, fromY, toX, toY, boardIndex, fast;
     char promoChar;
     char *p, *q;
     char buf[MSG_SIZ];
@@ -9733,10 +10444,15 @@ ParseGameHistory (char *game)
 
     /* Parse moves */
     boardIndex = blackPlaysFirst ? 1 : 0;
-    yynewstr(game);
+    if(!(fast = FastHistoryVariant())) yynewstr(game);
+    memset(sanPending, FALSE, sizeof(sanPending));
     for (;;) {
 	yyboardindex = boardIndex;
-	moveType = (ChessMove) Myylex();
+	if(fast && !FastHistoryToken(&game, boardIndex, &moveType)) {
+	    fast = FALSE; // hand rest of the list to the general parser
+	    yynewstr(game);
+	}
+	if(!fast) moveType = (ChessMove) Myylex();
 	switch (moveType) {
 	  case IllegalMove:		/* maybe suicide chess, etc. */
   if (appData.debugMode) {
@@ -9858,15 +10574,19 @@ ParseGameHistory (char *game)
 	    backwardMostMove = blackPlaysFirst ? 1 : 0;
 	    return;
 	}
-	(void) CoordsToAlgebraic(boards[boardIndex], PosFlags(boardIndex),
+	if(fast) // [HGM] fast history: keep the server's SAN until the move is displayed (VerifyHistory)
+	    safeStrCpy(parseList[boardIndex], yy_text, sizeof(parseList[boardIndex])/sizeof(parseList[boardIndex][0]));
+	else moveType = CoordsToAlgebraic(boards[boardIndex], PosFlags(boardIndex),
 				 fromY, fromX, toY, toX, promoChar,
 				 parseList[boardIndex]);
+	sanPending[boardIndex] = fast;
 	CopyBoard(boards[boardIndex + 1], boards[boardIndex]);
 	/* currentMoveString is set as a side-effect of yylex */
 	safeStrCpy(moveList[boardIndex], currentMoveString, sizeof(moveList[boardIndex])/sizeof(moveList[boardIndex][0]));
 	strcat(moveList[boardIndex], "\n");
 	boardIndex++;
 	ApplyMove(fromX, fromY, toX, toY, promoChar, boards[boardIndex]);
+	if(fast) continue;
         switch (MateTest(boards[boardIndex], PosFlags(boardIndex)) ) {
 	  case MT_NONE:
 	  case MT_STALEMATE:
@@ -9911,9 +10631,9 @@ ApplyMove (int fromX, int fromY, int toX, int toY, int promoChar, Board board)
 //      ChessSquare victim;
       int i;
 
-      if( killX >= 0 && killY >= 0 ) // [HGM] lion: Lion trampled over something
-//           victim = board[killY][killX],
-           board[killY][killX] = EmptySquare,
+      if( mainGen.killFile >= 0 && mainGen.killRank >= 0 ) // [HGM] lion: Lion trampled over something
+//           victim = board[mainGen.killRank][mainGen.killFile],
+           board[mainGen.killRank][mainGen.killFile] = EmptySquare,
            board[EP_STATUS] = EP_CAPTURE;
 
       if( board[toY][toX] != EmptySquare ) {
@@ -10232,12 +10952,13 @@ MakeMove (int fromX, int fromY, int toX, int toY, int promoChar)
     ChessSquare p = boards[forwardMostMove][toY][toX];
 //    forwardMostMove++; // [HGM] bare: moved downstream
 
-    if(killX >= 0 && killY >= 0) x = killX, y = killY; // [HGM] lion: make SAN move to intermediate square, if there is one
+    sanPending[forwardMostMove] = FALSE;
+    if(mainGen.killFile >= 0 && mainGen.killRank >= 0) x = mainGen.killFile, y = mainGen.killRank; // [HGM] lion: make SAN move to intermediate square, if there is one
     (void) CoordsToAlgebraic(boards[forwardMostMove],
 			     PosFlags(forwardMostMove),
 			     fromY, fromX, y, x, promoChar,
 			     s);
-    if(killX >= 0 && killY >= 0)
+    if(mainGen.killFile >= 0 && mainGen.killRank >= 0)
         sprintf(s + strlen(s), "%c%c%d", p == EmptySquare || toX == fromX && toY == fromY ? '-' : 'x', toX + AAA, toY + ONE - '0');
 
     if(serverMoves != NULL) { /* [HGM] write moves on file for broadcasting (should be separate routine, really) */
@@ -10352,7 +11073,7 @@ ShowMove (int fromX, int fromY, int toX, int toY)
 	currentMove = forwardMostMove;
     }
 
-    killX = killY = -1; // [HGM] lion: used up
+    mainGen.killFile = mainGen.killRank = -1; // [HGM] lion: used up
 
     if (instant) return;
 
@@ -11167,6 +11888,7 @@ int
 GameCheckSum ()
 {
 	int i, sum=0;
+	VerifyHistory(backwardMostMove, forwardMostMove);
 	for(i=backwardMostMove; i<forwardMostMove; i++) {
 		sum += pvInfoList[i].depth;
 		sum += StringCheckSum(parseList[i]);
@@ -11195,7 +11917,7 @@ GameEnds (ChessMove result, char *resultDetails, int whosays)
 	      result, resultDetails ? resultDetails : "(null)", whosays);
     }
 
-    fromX = fromY = killX = killY = -1; // [HGM] abort any move the user is entering. // [HGM] lion
+    fromX = fromY = mainGen.killFile = mainGen.killRank = -1; // [HGM] abort any move the user is entering. // [HGM] lion
 
     if(pausing) PauseEvent(); // can happen when we abort a paused game (New Game or Quit)
 
@@ -11661,8 +12383,9 @@ Reset (int redraw, int init)
 		redraw, init, gameMode);
     }
     pieceDefs = FALSE; // [HGM] gen: reset engine-defined piece moves
-    for(i=0; i<EmptySquare; i++) { FREE(pieceDesc[i]); pieceDesc[i] = NULL; }
+    for(i=0; i<EmptySquare; i++) { FREE(pieceDesc[i]); pieceDesc[i] = NULL; CompilePieceDesc(i); }
     CleanupTail(); // [HGM] vari: delete any stored variations
+    memset(sanPending, FALSE, sizeof(sanPending)); // [HGM] fast history
     CommentPopDown(); // [HGM] make sure no comments to the previous game keep hanging on
     pausing = pauseExamInvalid = FALSE;
     startedFromSetupPosition = blackPlaysFirst = FALSE;
@@ -11692,7 +12415,7 @@ Reset (int redraw, int init)
     ClearPremoveHighlights();
     gotPremove = FALSE;
     alarmSounded = FALSE;
-    killX = killY = -1; // [HGM] lion
+    mainGen.killFile = mainGen.killRank = -1; // [HGM] lion
 
     GameEnds(EndOfFile, NULL, GE_PLAYER);
     if(appData.serverMovesName != NULL) {
@@ -11753,10 +12476,24 @@ AutoPlayGameLoop ()
     }
 }
 
+static void
+ForgetAnalysis ()
+{   // [HGM] shard: the position the engine analyzes changed, so the thinking output still underway is stale
+    programStats.depth = 0;
+    if (first.usePing) { // and is ignored until the engine answers this
+	char buf[MSG_SIZ];
+	snprintf(buf, MSG_SIZ, "ping %d\n", ++first.lastPing);
+	SendToProgram(buf, &first);
+    }
+}
+
 void
 AnalyzeNextGame()
 {
-    ReloadGame(1); // next game
+    if(appData.annotateShards > 1) { // [HGM] shard: skip the games other instances take care of
+	if(!ReloadGame(appData.annotateShards)) ExitEvent(0); // our share of the file is done
+    } else ReloadGame(1); // next game
+    if(gameMode == AnalyzeFile) ForgetAnalysis();
 }
 
 int
@@ -11832,6 +12569,7 @@ AutoPlayOneMove ()
     }
     DisplayMove(currentMove);
     SendMoveToProgram(currentMove++, &first);
+    if (gameMode == AnalyzeFile) ForgetAnalysis(); // annotateDepth must not be met by the previous position
     DisplayBothClocks();
     DrawPosition(FALSE, boards[currentMove]);
     // [HGM] PV info: always display, routine tests if empty
@@ -12071,7 +12809,7 @@ LoadGameOneMove (ChessMove readAhead)
 
 	thinkOutput[0] = NULLCHAR;
 	MakeMove(fromX, fromY, toX, toY, promoChar);
-	killX = killY = -1; // [HGM] lion: used up
+	mainGen.killFile = mainGen.killRank = -1; // [HGM] lion: used up
 	currentMove = forwardMostMove;
 	return TRUE;
     }
@@ -12115,6 +12853,34 @@ LoadGameFromFile (char *filename, int n, char *title, int useList)
     return LoadGame(f, n, title, FALSE);
 }
 
+int
+LoadShardGame (char *filename)
+{   // [HGM] shard: index the game file once, and start annotating the first game assigned to this instance
+    FILE *f;
+    char buf[MSG_SIZ];
+    int error;
+
+    if(appData.annotateShard < 1 || appData.annotateShard > appData.annotateShards) {
+	DisplayFatalError(_("annotateShard must be between 1 and annotateShards"), 0, 2);
+	return FALSE;
+    }
+    f = fopen(filename, "rb");
+    if (f == NULL) {
+	snprintf(buf, sizeof(buf),  _("Can't open \"%s\""), filename);
+	DisplayFatalError(buf, errno, 2);
+	return FALSE;
+    }
+    if((error = GameListBuild(f))) {
+	DisplayFatalError(_("Cannot build game list"), error, 2);
+	return FALSE;
+    }
+    if(ListEmpty(&gameList) || ((ListGame *) gameList.tailPred)->number < appData.annotateShard) {
+	ExitEvent(0); // fewer games than instances; nothing to do for us
+	return FALSE;
+    }
+    appData.loadGameIndex = -1; // auto-step through the games
+    return LoadGame(f, appData.annotateShard, filename, TRUE);
+}
 
 void
 MakeRegisteredMove ()
@@ -12541,7 +13307,7 @@ GameContainsPosition (FILE *f, ListGame *lg)
     if(lg->gameInfo.variant != gameInfo.variant) return -1; // wrong variant
     if(appData.eloThreshold1 && (lg->gameInfo.whiteRating < appData.eloThreshold1 && lg->gameInfo.blackRating < appData.eloThreshold1)) return -1;
     if(appData.eloThreshold2 && (lg->gameInfo.whiteRating < appData.eloThreshold2 || lg->gameInfo.blackRating < appData.eloThreshold2)) return -1;
-    if(appData.dateThreshold && (!lg->gameInfo.date || atoi(lg->gameInfo.date) < appData.dateThreshold)) return -1;
+    if(appData.dateThreshold && GameListTagValue(lg, GLT_DATE) < appData.dateThreshold) return -1; // '?' if no date
     if(!initDone) {
 	for(next = WhitePawn; next<EmptySquare; next++) keys[next] = random()>>8 ^ random()<<6 ^random()<<20;
 	initDone = TRUE;
@@ -12559,9 +13325,9 @@ GameContainsPosition (FILE *f, ListGame *lg)
     yynewfile(f);
     while(1) {
 	yyboardindex = scratch;
-	quickFlag = plyNr+1;
+	mainGen.quick = plyNr+1;
 	next = Myylex();
-	quickFlag = 0;
+	mainGen.quick = 0;
 	switch(next) {
 	    case PGNTag:
 		if(plyNr) return -1; // after we have seen moves, any tags will be start of next game
@@ -12655,7 +13421,7 @@ LoadGame (FILE *f, int gameNumber, char *title, int useList)
     if (gameMode != BeginningOfGame) {
       Reset(FALSE, TRUE);
     }
-    killX = killY = -1; // [HGM] lion: in case we did not Reset
+    mainGen.killFile = mainGen.killRank = -1; // [HGM] lion: in case we did not Reset
 
     gameFileFP = f;
     if (lastLoadGameFP != NULL && lastLoadGameFP != f) {
@@ -13356,7 +14122,6 @@ SavePart (char *str)
     return buf;
 }
 
-#define PGN_MAX_LINE 75
 
 #define PGN_SIDE_WHITE  0
 #define PGN_SIDE_BLACK  1
@@ -13446,6 +14211,7 @@ SaveGamePGN2 (FILE *f)
     char move_buffer[100]; /* [AS] Buffer for move+PV info */
 
     offset = backwardMostMove & (~1L); /* output move numbers start at 1 */
+    VerifyHistory(backwardMostMove, forwardMostMove);
 
     PrintPGNTags(f, &gameInfo);
 
@@ -13617,6 +14383,7 @@ SaveGameOldStyle (FILE *f)
     time_t tm;
 
     tm = time((time_t *) NULL);
+    VerifyHistory(backwardMostMove, forwardMostMove);
 
     fprintf(f, "# %s game file -- %s", programName, ctime(&tm));
     PrintOpponents(f);
@@ -14248,6 +15015,7 @@ EditCommentEvent ()
 {
     char title[MSG_SIZ];
 
+    VerifyHistory(currentMove - 1, currentMove);
     if (currentMove < 1 || parseList[currentMove - 1][0] == NULLCHAR) {
       safeStrCpy(title, _("Edit comment"), sizeof(title)/sizeof(title[0]));
     } else {
@@ -15081,7 +15849,7 @@ EditPositionMenuEvent (ChessSquare selection, int x, int y)
 
     switch (selection) {
       case ClearBoard:
-	fromX = fromY = killX = killY = -1; // [HGM] abort any move entry in progress
+	fromX = fromY = mainGen.killFile = mainGen.killRank = -1; // [HGM] abort any move entry in progress
 	MarkTargetSquares(1);
 	CopyBoard(currentBoard, boards[0]);
 	CopyBoard(menuBoard, initialPosition);
@@ -15510,6 +16278,7 @@ StopObservingEvent ()
     /* Stop observing current games */
     SendToICS(ics_prefix);
     SendToICS("unobserve\n");
+    RelayClear(); // [HGM] relay: games that were unobserved will never send their end
 }
 
 void
@@ -15534,7 +16303,7 @@ ForwardInner (int target)
 
     seekGraphUp = FALSE;
     MarkTargetSquares(1);
-    fromX = fromY = killX = killY = -1; // [HGM] abort any move entry in progress
+    fromX = fromY = mainGen.killFile = mainGen.killRank = -1; // [HGM] abort any move entry in progress
 
     if (gameMode == PlayFromGameFile && !pausing)
       PauseEvent();
@@ -15653,7 +16422,7 @@ BackwardInner (int target)
     if (gameMode == EditPosition) return;
     seekGraphUp = FALSE;
     MarkTargetSquares(1);
-    fromX = fromY = killX = killY = -1; // [HGM] abort any move entry in progress
+    fromX = fromY = mainGen.killFile = mainGen.killRank = -1; // [HGM] abort any move entry in progress
     if (currentMove <= backwardMostMove) {
 	ClearHighlights();
 	DrawPosition(full_redraw, boards[currentMove]);
@@ -17093,6 +17862,7 @@ DisplayMove (int moveNumber)
     char cpThinkOutput[MSG_SIZ];
 
     if(appData.noGUI) return; // [HGM] fast: suppress display of moves
+    VerifyHistory(moveNumber, moveNumber + 1);
 
     if (moveNumber == forwardMostMove - 1 ||
 	gameMode == AnalyzeMode || gameMode == AnalyzeFile) {
@@ -17147,6 +17917,7 @@ DisplayComment (int moveNumber, char *text)
 {
     char title[MSG_SIZ];
 
+    VerifyHistory(moveNumber, moveNumber + 1);
     if (moveNumber < 0 || parseList[moveNumber][0] == NULLCHAR) {
       safeStrCpy(title, "Comment", sizeof(title)/sizeof(title[0]));
     } else {
@@ -18404,6 +19175,7 @@ PushInner (int firstMove, int lastMove)
 {
 	int i, j, nrMoves = lastMove - firstMove;
 
+	VerifyHistory(firstMove, lastMove); // the stack has no pending flags
 	// push current tail of game on stack
 	savedResult[storedGames] = gameInfo.result;
 	savedDetails[storedGames] = gameInfo.resultDetails;
@@ -157,6 +157,7 @@ void UserMoveEvent P((int fromX, int fromY, int toX, int toY, int promoChar));
 void DecrementClocks P((void));
 char *TimeString P((long millisec));
 void AutoPlayGameLoop P((void));
+void DrainPacedOutput P((void));
 void AdjustClock P((Boolean which, int dir));
 void DisplayBothClocks P((void));
 void EditPositionMenuEvent P((ChessSquare selection, int x, int y));
@@ -165,6 +166,7 @@ int ParseTimeControl P((char *tc, float ti, int mps));
 void EscapeExpand(char *p, char *q);
 void ProcessICSInitScript P((FILE * f));
 void EditCommentEvent P((void));
+void VerifyHistory P((int first, int last));
 void ReplaceComment P((int index, char *text));
 int ReplaceTags P((char *tags, GameInfo *gi));/* returns nonzero on error */
 void AppendComment P((int index, char *text, Boolean addBraces));
@@ -273,6 +275,8 @@ int GameListBuild P((FILE *));
 void GameListInitGameInfo P((GameInfo *));
 char *GameListLine P((int, GameInfo *));
 char * GameListLineFull P(( int, GameInfo *));
+int GameListLineMatches P((ListGame *lg, char *pattern));
+int GameListTagValue P((ListGame *lg, int tag));
 void InitSearch P((void));
 int GameContainsPosition P((FILE *f, ListGame *lg));
 void GLT_TagsToList P(( char * tags ));
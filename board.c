@@ -114,6 +114,9 @@ int squareSize, lineGap;
 
 int damage[2][BOARD_RANKS][BOARD_FILES];
 
+static int lastBoardValid[2] = {0, 0};
+static Board lastBoard[2];
+
 /* There can be two pieces being animated at once: a player
    can begin dragging a piece before the remote opponent has moved. */
 
@@ -557,17 +560,128 @@ EndAnimation (AnimNr anr, Pnt *finish)
   }
 }
 
+/* [HGM] anim: the game animation is driven by a timer, so that engine output,
+   ICS traffic and clocks keep being served while a piece is in flight. The frame
+   to show is derived from the real time elapsed since the animation started, so
+   frames are dropped rather than the move delayed when drawing falls behind.
+   While in flight the to-square keeps showing its old contents; it is redrawn
+   when the piece lands. A new move arriving before that either continues the
+   flight (next leg of a multi-leg move) or makes the piece land immediately. */
+
+#define MAX_LEGS 3
+
+static struct {
+    Boolean active;
+    ChessSquare piece, victim, landing;
+    int frame, nFrames, nLegs, flash, toX, toY;
+    int leg[MAX_LEGS][4];
+    Pnt finish, frames[MAX_LEGS * (kFactor * 2 + 1)];
+    Board board;
+    TimeMark begin;
+} flight;
+
+static int
+InFlight (int nr, int row, int column, ChessSquare *piece, int flash)
+{   // to-square of the flying piece shows what was there before, and does not flash yet
+    if(nr || !flight.active || row != flight.toY || column != flight.toX) return flash;
+    flight.landing = *piece; *piece = flight.victim; flight.flash |= flash;
+    return 0;
+}
+
+static void
+FinishAnimation (int redraw)
+{   // let the piece in flight land; without redraw the caller is about to draw the board itself
+    Board shown;
+    int n, boom = FALSE;
+
+    if(!flight.active) return;
+    flight.active = FALSE;
+    EndAnimation(Game, &flight.finish);
+    damage[0][flight.toY][flight.toX] |= True;
+    if(!redraw) return;
+    if(flight.flash) DrawSquare(flight.toY, flight.toX, flight.landing, 1);
+    CopyBoard(shown, lastBoard[0]);
+    for(n=0; n<flight.nLegs; n++) {
+	int *l = flight.leg[n];
+	if(Explode(flight.board, l[0], l[1], l[2], l[3])) { // mark as damaged
+	    int i,j;
+	    for(i=0; i<BOARD_WIDTH; i++) for(j=0; j<BOARD_HEIGHT; j++)
+		if((i-l[2])*(i-l[2]) + (j-l[3])*(j-l[3]) < 6) damage[0][j][i] |=  1 + ((i-l[2] ^ j-l[3]) & 1);
+	    boom = TRUE;
+	}
+    }
+    DrawPosition(FALSE, boom ? shown : NULL); // explosion drew the pre-move position
+}
+
+void
+AnimationTimerEvent ()
+{
+    TimeMark now;
+    int n, speed = Max(appData.animSpeed, 1);
+    long elapsed;
+
+    if(!flight.active) return;
+    GetTimeMark(&now);
+    elapsed = SubtractTimeMarks(&now, &flight.begin);
+    n = elapsed / speed;
+    if(n >= flight.nFrames) { FinishAnimation(TRUE); return; }
+    if(n > flight.frame) AnimationFrame(Game, &flight.frames[flight.frame = n], flight.piece);
+    if(!AnimationTimerRunning()) StartAnimationTimer((n + 1)*speed - elapsed);
+}
+
 static void
-FrameSequence (AnimNr anr, ChessSquare piece, int startColor, Pnt *start, Pnt *finish, Pnt frames[], int nFrames)
+DrawFlyingPiece ()
+{   // [HGM] anim: like DrawDragPiece, restore the piece in flight after (partial) board redraw
+    if(!flight.active) return;
+    AnimationFrame(Game, &anims[Game].prevFrame, flight.piece);
+}
+
+static void
+AddLeg (Board board, int fromX, int fromY, int toX, int toY)
 {
-  int n;
+  int hop, nFrames, startColor, endColor;
+  Pnt start, finish, mid;
 
-  BeginAnimation(anr, piece, EmptySquare, startColor, start);
-  for (n = 0; n < nFrames; n++) {
-    AnimationFrame(anr, &(frames[n]), piece);
-    FrameDelay(appData.animSpeed);
+#if DONT_HOP
+  hop = FALSE;
+#else
+  hop = abs(fromX-toX) == 1 && abs(fromY-toY) == 2 || abs(fromX-toX) == 2 && abs(fromY-toY) == 1;
+#endif
+
+  ScreenSquare(fromX, fromY, &start, &startColor);
+  ScreenSquare(toX, toY, &finish, &endColor);
+
+  if (hop) {
+    /* Knight: make straight movement then diagonal */
+    if (abs(toY - fromY) < abs(toX - fromX)) {
+       mid.x = start.x + (finish.x - start.x) / 2;
+       mid.y = start.y;
+     } else {
+       mid.x = start.x;
+       mid.y = start.y + (finish.y - start.y) / 2;
+     }
+  } else {
+    mid.x = start.x + (finish.x - start.x) / 2;
+    mid.y = start.y + (finish.y - start.y) / 2;
   }
-  EndAnimation(anr, finish);
+
+  if(!flight.active) { // first leg: lift the piece off its square
+    BeginAnimation(Game, flight.piece, EmptySquare, startColor, &start);
+    flight.nFrames = flight.nLegs = 0; flight.frame = -1; flight.flash = 0;
+    flight.active = TRUE;
+    GetTimeMark(&flight.begin);
+  } else damage[0][flight.toY][flight.toX] |= True; // no longer held
+
+  /* Don't use as many frames for very short moves */
+  Tween(&start, &mid, &finish, kFactor - (abs(toY - fromY) + abs(toX - fromX) <= 2),
+	flight.frames + flight.nFrames, &nFrames);
+  flight.nFrames += nFrames;
+  flight.finish = finish;
+  flight.leg[flight.nLegs][0] = fromX; flight.leg[flight.nLegs][1] = fromY;
+  flight.leg[flight.nLegs][2] = flight.toX = toX; flight.leg[flight.nLegs][3] = flight.toY = toY;
+  flight.nLegs++;
+  flight.victim = flight.landing = board[toY][toX];
+  CopyBoard(flight.board, board);
 }
 
 void
@@ -599,12 +713,8 @@ void
 AnimateMove (Board board, int fromX, int fromY, int toX, int toY)
 {
   ChessSquare piece;
-  int hop, x = toX, y = toY;
-  Pnt      start, finish, mid;
-  Pnt      frames[kFactor * 2 + 1];
-  int	      nFrames, startColor, endColor;
 
-  if(killX >= 0 && IS_LION(board[fromY][fromX])) Roar();
+  if(mainGen.killFile >= 0 && IS_LION(board[fromY][fromX])) Roar();
 
   /* Are we animating? */
   if (!appData.animate || appData.blindfold)
@@ -620,49 +730,16 @@ AnimateMove (Board board, int fromX, int fromY, int toX, int toY)
   piece = board[fromY][fromX];
   if (piece >= EmptySquare) return;
 
-  if(killX >= 0) toX = killX, toY = killY; // [HGM] lion: first to kill square
-
-again:
-
-#if DONT_HOP
-  hop = FALSE;
-#else
-  hop = abs(fromX-toX) == 1 && abs(fromY-toY) == 2 || abs(fromX-toX) == 2 && abs(fromY-toY) == 1;
-#endif
-
-  ScreenSquare(fromX, fromY, &start, &startColor);
-  ScreenSquare(toX, toY, &finish, &endColor);
-
-  if (hop) {
-    /* Knight: make straight movement then diagonal */
-    if (abs(toY - fromY) < abs(toX - fromX)) {
-       mid.x = start.x + (finish.x - start.x) / 2;
-       mid.y = start.y;
-     } else {
-       mid.x = start.x;
-       mid.y = start.y + (finish.y - start.y) / 2;
-     }
-  } else {
-    mid.x = start.x + (finish.x - start.x) / 2;
-    mid.y = start.y + (finish.y - start.y) / 2;
+  if (flight.active) { // [HGM] anim: coalesce with the move still in flight
+    if (fromX != flight.toX || fromY != flight.toY || flight.piece != piece || flight.nLegs + 1 + (mainGen.killFile >= 0) > MAX_LEGS)
+      FinishAnimation(TRUE); // unrelated move: previous one lands at once
   }
+  flight.piece = piece;
 
-  /* Don't use as many frames for very short moves */
-  if (abs(toY - fromY) + abs(toX - fromX) <= 2)
-    Tween(&start, &mid, &finish, kFactor - 1, frames, &nFrames);
-  else
-    Tween(&start, &mid, &finish, kFactor, frames, &nFrames);
-  FrameSequence(Game, piece, startColor, &start, &finish, frames, nFrames);
-  if(Explode(board, fromX, fromY, toX, toY)) { // mark as damaged
-    int i,j;
-    for(i=0; i<BOARD_WIDTH; i++) for(j=0; j<BOARD_HEIGHT; j++)
-      if((i-toX)*(i-toX) + (j-toY)*(j-toY) < 6) damage[0][j][i] |=  1 + ((i-toX ^ j-toY) & 1);
-  }
+  if(mainGen.killFile >= 0) AddLeg(board, fromX, fromY, mainGen.killFile, mainGen.killRank), fromX = mainGen.killFile, fromY = mainGen.killRank; // [HGM] lion: first to kill square
+  AddLeg(board, fromX, fromY, toX, toY);
 
-  /* Be sure end square is redrawn */
-  damage[0][toY][toX] |= True;
-
-  if(toX != x || toY != y) { fromX = toX; fromY = toY; toX = x; toY = y; goto again; } // second leg
+  AnimationTimerEvent(); // shows first frame and starts the clock
 }
 
 void
@@ -913,8 +990,6 @@ DrawPosition (int repaint, Board board)
 {
     int i, j, do_flash, exposeAll = False;
     static int lastFlipView = 0;
-    static int lastBoardValid[2] = {0, 0};
-    static Board lastBoard[2];
     static char lastMarker[BOARD_RANKS][BOARD_FILES];
     int rrow, rcol;
     int nr = twoBoards*partnerUp;
@@ -944,6 +1019,7 @@ DrawPosition (int repaint, Board board)
 	/* If too much changes (begin observing new game, etc.), don't
 	   do flashing */
 	do_flash = too_many_diffs(board, lastBoard[nr]) ? 0 : 1;
+	if(!do_flash && !nr) FinishAnimation(FALSE); // new position: piece in flight has no business here
 
 	/* Special check for castling so we don't flash both the king
 	   and the rook (just flash the king). */
@@ -961,7 +1037,9 @@ DrawPosition (int repaint, Board board)
 	  for (j = 0; j < BOARD_WIDTH; j++)
 	    if (((board[i][j] != lastBoard[nr][i][j] || !nr && marker[i][j] != lastMarker[i][j]) && board[i][j] == EmptySquare)
 		|| damage[nr][i][j]) {
-		DrawSquare(i, j, board[i][j], 0);
+		ChessSquare piece = board[i][j];
+		InFlight(nr, i, j, &piece, 0);
+		DrawSquare(i, j, piece, 0);
 		if(damage[nr][i][j] & 2) {
 		    drawHighlight(j, i, 0);   // repair arrow damage
 		    if(lineGap) damage[nr][i][j] = False; // this flushed the square as well
@@ -972,10 +1050,14 @@ DrawPosition (int repaint, Board board)
 	for (i = 0; i < BOARD_HEIGHT; i++)
 	  for (j = 0; j < BOARD_WIDTH; j++)
 	    if (board[i][j] != lastBoard[nr][i][j] || !nr && marker[i][j] != lastMarker[i][j]) {
-		DrawSquare(i, j, board[i][j], do_flash);
+		ChessSquare piece = board[i][j];
+		int flash = InFlight(nr, i, j, &piece, do_flash);
+		DrawSquare(i, j, piece, flash);
 		damage[nr][i][j] = 1; // mark for expose
 	    }
     } else {
+	if(!nr) FinishAnimation(FALSE);
+
 	if (lineGap > 0)
 	  DrawGrid();
 
@@ -1019,6 +1101,7 @@ DrawPosition (int repaint, Board board)
 
     /* If piece being dragged around board, must redraw that too */
     DrawDragPiece();
+    if(!nr) DrawFlyingPiece();
 
     if(exposeAll)
 	GraphExpose(currBoard, 0, 0, BOARD_WIDTH*(squareSize + lineGap) + lineGap, BOARD_HEIGHT*(squareSize + lineGap) + lineGap);
@@ -1048,6 +1131,22 @@ DrawPosition (int repaint, Board board)
     if(nr) SwitchWindow(1);
 }
 
+/* [HGM] diagram: paint a complete position on the current drawable, as a full
+   repaint of DrawPosition would, but without exposing it on any window */
+
+void
+DrawDiagram (Board board)
+{
+    int i, j;
+
+    if (lineGap > 0)
+      DrawGrid();
+
+    for (i = 0; i < BOARD_HEIGHT; i++)
+      for (j = 0; j < BOARD_WIDTH; j++)
+	DrawSquare(i, j, board[i][j], 0);
+}
+
 /* [AS] Arrow highlighting support */
 
 static double A_WIDTH = 5; /* Width of arrow body */
@@ -93,6 +93,7 @@ void DragPieceMove P((int x, int y));
 void DrawBorder P((int x, int y, int type, int odd));
 void FlashDelay P((int flash_delay));
 void SwitchWindow P((int main));
+void DrawDiagram P((Board board));
 
 extern int damage[2][BOARD_RANKS][BOARD_FILES];
 extern Option *currBoard;
@@ -494,6 +494,9 @@ typedef struct {
     char *remoteShell;
     char *remoteUser;
     float timeDelay;
+    int annotateDepth;  /* [HGM] shard: step on in AnalyzeFile once this depth is reached */
+    int annotateShards; /* number of xboard instances sharing one game file in AnalyzeFile */
+    int annotateShard;  /* which of those games (1..annotateShards) this instance takes */
     char *timeControl;
     Boolean trueColors;
     Boolean icsActive;
@@ -518,6 +521,8 @@ typedef struct {
     char *loadPositionFile;
     int loadPositionIndex;  /* position # within file */
     char *savePositionFile;
+    char *diagramFile;      /* [HGM] diagram: image-file name pattern for headless export */
+    int diagramJobs;        /* [HGM] diagram: number of processes to render them */
     Boolean fischerCastling;/* [HGM] fischer: allow Fischr castling in any variant */
     Boolean matchMode;
     int matchGames;
@@ -721,6 +726,7 @@ typedef struct {
     int zippyMaxGames;
     int zippyReplayTimeout; /*seconds*/
     int zippyShortGame; /* [HGM] aborter   */
+    int zippyMaxPending; /* [HGM] pending: challenges held while busy */
 #endif
     Boolean lowTimeWarning; /* [HGM] low time */
     Boolean quitNext;
@@ -728,6 +734,10 @@ typedef struct {
 
     char *serverFileName;
     char *serverMovesName;
+    char *icsRecord;    /* [HGM] replay: log of raw ICS input, with timing */
+    char *icsReplay;    /* recorded session to play back in stead of connecting */
+    float icsReplaySpeed;
+    char *relayFile;    /* [HGM] relay: PGN file (name with %d for game number) for every observed game */
     char *finger;
     Boolean suppressLoadMoves;
     int serverPause;
@@ -140,6 +140,7 @@ int GenericReadout P((Option *currentOption, int selected));
 int PopDown P((DialogClass n));
 void MarkMenu P((char *item, int dlgNr));
 int AppendText P((Option *opt, char *s));
+void TruncateText P((Option *opt, int pos));
 void AppendColorized P((Option *opt, char *s, int count));
 void Show P((Option *opt, int hide));
 int  IcsHist P((int dir, Option *opt, DialogClass dlg));
@@ -55,6 +55,7 @@
 #include <math.h>
 #include <cairo/cairo.h>
 #include <cairo/cairo-xlib.h>
+#include <cairo/cairo-svg.h>
 #include <librsvg/rsvg.h>
 #include <librsvg/rsvg-cairo.h>
 
@@ -70,12 +71,21 @@ extern char *getenv();
 # endif /* not HAVE_STRING_H */
 #endif /* not STDC_HEADERS */
 
+#if HAVE_UNISTD_H
+# include <unistd.h>
+#endif
+
+#if HAVE_SYS_WAIT_H
+# include <sys/wait.h>
+#endif
+
 #if ENABLE_NLS
 #include <locale.h>
 #endif
 
 #include "common.h"
 
+#include "frontend.h"
 #include "backend.h"
 #include "board.h"
 #include "menus.h"
@@ -106,12 +116,52 @@ Boolean cairoAnimate;
 Option *currBoard;
 cairo_surface_t *csBoardWindow;
 static cairo_surface_t *pngPieceImages[2][(int)BlackPawn+4];   // png 256 x 256 images
-static cairo_surface_t *pngPieceBitmaps[2][(int)BlackPawn];    // scaled pieces as used
-static cairo_surface_t *pngPieceBitmaps2[2][(int)BlackPawn+4]; // scaled pieces in store
+static int pieceImageNr[(int)BlackPawn];                       // image used for each piece type in current variant
 static RsvgHandle *svgPieces[2][(int)BlackPawn+4]; // vector pieces in store
+static int vectorDiagram;                          // [HGM] diagram: drawing on an SVG surface
+
+/* [HGM] pieces: scaled (and recolored) piece images are only made when a piece is first drawn,
+   and kept for a few square sizes and color schemes, so that going back to an earlier size,
+   or switching variants, does not require them to be rendered again.
+ */
+#define PIECE_SETS 4
+
+typedef struct {
+    int size, age;
+    unsigned int scheme;
+    cairo_surface_t *bitmap[2][(int)BlackPawn+4];
+} PieceSet;
+
+static PieceSet pieceSets[PIECE_SETS], *pieceSet = pieceSets;
 static cairo_surface_t *pngBoardBitmap[2], *pngOriginalBoardBitmap[2];
 int useTexture, textureW[2], textureH[2];
 
+/* [HGM] tiles: completely drawn squares are kept, so that drawing a square that looks like one
+   drawn before is a single copy. They are identified by everything that went into them,
+   and all thrown away when board size, pieces or theme change.
+ */
+#define TILE_CACHE 512 /* power of 2 */
+
+typedef struct {
+    cairo_surface_t *tile, *bitmap;
+    int piece, color, x0, y0, marker, align;
+    char top[8], bottom[8];
+} SquareTile;
+
+static SquareTile tileCache[TILE_CACHE];
+static int tileSize;
+
+static void
+FlushTileCache ()
+{
+    int i;
+    for(i=0; i<TILE_CACHE; i++) if(tileCache[i].tile) {
+	cairo_surface_destroy(tileCache[i].tile);
+	tileCache[i].tile = NULL;
+    }
+    tileSize = squareSize;
+}
+
 #define pieceToSolid(piece) &pieceBitmap[SOLID][(piece) % (int)BlackPawn]
 #define pieceToOutline(piece) &pieceBitmap[OUTLINE][(piece) % (int)BlackPawn]
 
@@ -136,38 +186,35 @@ SwitchWindow (int main)
 void
 SelectPieces(VariantClass v)
 {
-    int i;
-    for(i=0; i<2; i++) {
 	int p;
 	for(p=0; p<=(int)WhiteKing; p++)
-	   pngPieceBitmaps[i][p] = pngPieceBitmaps2[i][p]; // defaults
+	   pieceImageNr[p] = p; // defaults
 	if(v == VariantShogi && BOARD_HEIGHT != 7) { // no exceptions in Tori Shogi
-	   pngPieceBitmaps[i][(int)WhiteCannon] = pngPieceBitmaps2[i][(int)WhiteTokin];
-	   pngPieceBitmaps[i][(int)WhiteNightrider] = pngPieceBitmaps2[i][(int)WhiteKing+2];
-	   pngPieceBitmaps[i][(int)WhiteGrasshopper] = pngPieceBitmaps2[i][(int)WhiteKing+3];
-	   pngPieceBitmaps[i][(int)WhiteSilver] = pngPieceBitmaps2[i][(int)WhiteKing+4];
-	   pngPieceBitmaps[i][(int)WhiteQueen] = pngPieceBitmaps2[i][(int)WhiteLance];
-	   pngPieceBitmaps[i][(int)WhiteFalcon] = pngPieceBitmaps2[i][(int)WhiteMonarch]; // for Sho Shogi
+	   pieceImageNr[(int)WhiteCannon] = WhiteTokin;
+	   pieceImageNr[(int)WhiteNightrider] = WhiteKing+2;
+	   pieceImageNr[(int)WhiteGrasshopper] = WhiteKing+3;
+	   pieceImageNr[(int)WhiteSilver] = WhiteKing+4;
+	   pieceImageNr[(int)WhiteQueen] = WhiteLance;
+	   pieceImageNr[(int)WhiteFalcon] = WhiteMonarch; // for Sho Shogi
 	}
 #ifdef GOTHIC
 	if(v == VariantGothic) {
-	   pngPieceBitmaps[i][(int)WhiteMarshall] = pngPieceBitmaps2[i][(int)WhiteSilver];
+	   pieceImageNr[(int)WhiteMarshall] = WhiteSilver;
 	}
 #endif
 	if(v == VariantSChess) {
-	   pngPieceBitmaps[i][(int)WhiteAngel]    = pngPieceBitmaps2[i][(int)WhiteFalcon];
-	   pngPieceBitmaps[i][(int)WhiteMarshall] = pngPieceBitmaps2[i][(int)WhiteAlfil];
+	   pieceImageNr[(int)WhiteAngel]    = WhiteFalcon;
+	   pieceImageNr[(int)WhiteMarshall] = WhiteAlfil;
 	}
 	if(v == VariantChuChess) {
-	   pngPieceBitmaps[i][(int)WhiteNightrider] = pngPieceBitmaps2[i][(int)WhiteLion];
+	   pieceImageNr[(int)WhiteNightrider] = WhiteLion;
 	}
 	if(v == VariantChu) {
-	   pngPieceBitmaps[i][(int)WhiteNightrider] = pngPieceBitmaps2[i][(int)WhiteKing+1];
-	   pngPieceBitmaps[i][(int)WhiteUnicorn] = pngPieceBitmaps2[i][(int)WhiteCat];
-	   pngPieceBitmaps[i][(int)WhiteSilver]  = pngPieceBitmaps2[i][(int)WhiteSword];
-	   pngPieceBitmaps[i][(int)WhiteFalcon]  = pngPieceBitmaps2[i][(int)WhiteDagger];
+	   pieceImageNr[(int)WhiteNightrider] = WhiteKing+1;
+	   pieceImageNr[(int)WhiteUnicorn] = WhiteCat;
+	   pieceImageNr[(int)WhiteSilver]  = WhiteSword;
+	   pieceImageNr[(int)WhiteFalcon]  = WhiteDagger;
 	}
-    }
 }
 
 #define BoardSize int
@@ -181,6 +228,8 @@ InitDrawingSizes (BoardSize boardSize, int flags)
 
     if(!mainOptions[W_BOARD].handle) return;
 
+    FlushTileCache();
+
     if(boardSize == -2 && gameInfo.variant != oldVariant
                        && oldNrOfFiles && oldNrOfFiles != BOARD_WIDTH) { // called because variant switch changed board format
 	squareSize = ((squareSize + lineGap) * oldNrOfFiles + 0.5*BOARD_WIDTH) / BOARD_WIDTH; // keep total width fixed
@@ -361,8 +410,8 @@ ScaleOnePiece (int color, int piece)
   img = pngPieceImages[color][piece];
 
   // create new bitmap to hold scaled piece image (and remove any old)
-  if(pngPieceBitmaps2[color][piece]) cairo_surface_destroy (pngPieceBitmaps2[color][piece]);
-  pngPieceBitmaps2[color][piece] = cs = cairo_image_surface_create (CAIRO_FORMAT_ARGB32, squareSize, squareSize);
+  if(pieceSet->bitmap[color][piece]) cairo_surface_destroy (pieceSet->bitmap[color][piece]);
+  pieceSet->bitmap[color][piece] = cs = cairo_image_surface_create (CAIRO_FORMAT_ARGB32, squareSize, squareSize);
 
   if(!img) return;
 
@@ -378,37 +427,73 @@ ScaleOnePiece (int color, int piece)
   if(!appData.trueColors || !*appData.pieceDirectory) { // operate on bitmap to color it (king-size hack...)
     int stride = cairo_image_surface_get_stride(cs)/4;
     int *buf = (int *) cairo_image_surface_get_data(cs);
-    int i, j, p;
+    int i, j, p, v, mix[511];
     sscanf(color ? appData.blackPieceColor+1 : appData.whitePieceColor+1, "%x", &p); // replacement color
+    // the new color only depends on the fraction of black or white that has to be replaced,
+    // so calculate it once for every possible fraction, rather than for every pixel
+    for(v=-255; v<256; v++) {
+	float f = v/255.;
+	mix[v+255] = ((int)(f*(p&0xFF0000)) & 0xFF0000) + ((int)(f*(p&0xFF00)) & 0xFF00) + (int)(f*(p&0xFF));
+    }
     cairo_surface_flush(cs);
-    for(i=0; i<squareSize; i++) for(j=0; j<squareSize; j++) {
-	int r, a;
-	float f;
-	unsigned int c = buf[i*stride + j];
-	a = c >> 24; r = c >> 16 & 255;     // alpha and red, where red is the 'white' weight, since white is #FFFFCC in the source images
-        f = (color ? a - r : r)/255.;       // fraction of black or white in the mix that has to be replaced
-	buf[i*stride + j] = c & 0xFF000000; // alpha channel is kept at same opacity
-	buf[i*stride + j] += ((int)(f*(p&0xFF0000)) & 0xFF0000) + ((int)(f*(p&0xFF00)) & 0xFF00) + (int)(f*(p&0xFF)); // add desired fraction of new color
-	if(color) buf[i*stride + j] += r | r << 8 | r << 16; // details on black pieces get their weight added in pure white
+    for(i=0; i<squareSize; i++) {
+      int *row = buf + i*stride;
+      for(j=0; j<squareSize; j++) {
+	unsigned int c = row[j];
+	int a = c >> 24, r = c >> 16 & 255; // alpha and red, where red is the 'white' weight, since white is #FFFFCC in the source images
 	if(appData.monoMode) {
-	    if(a < 64) buf[i*stride + j] = 0; // if not opaque enough, totally transparent
-	    else if(2*r < a) buf[i*stride + j] = 0xFF000000; // if not light enough, totally black
-            else buf[i*stride + j] = 0xFFFFFFFF; // otherwise white
-	}
+	    if(a < 64) row[j] = 0; // if not opaque enough, totally transparent
+	    else if(2*r < a) row[j] = 0xFF000000; // if not light enough, totally black
+            else row[j] = 0xFFFFFFFF; // otherwise white
+	} else if(color) // details on black pieces get their weight added in pure white
+	    row[j] = (c & 0xFF000000) + mix[a - r + 255] + (r | r << 8 | r << 16);
+	else row[j] = (c & 0xFF000000) + mix[r + 255]; // alpha channel is kept at same opacity
+      }
     }
     cairo_surface_mark_dirty(cs);
   }
 }
 
+static cairo_surface_t *
+PieceBitmap (int color, int piece)
+{   // scaled image of the piece type as used in the current variant, made on first use
+    int p = pieceImageNr[piece];
+    if(!pieceSet->bitmap[color][p]) ScaleOnePiece(color, p);
+    return pieceSet->bitmap[color][p];
+}
+
+static void
+FlushPieceSet (PieceSet *set)
+{
+    int i, p;
+    for(i=0; i<2; i++) for(p=0; p<BlackPawn+4; p++) {
+	if(set->bitmap[i][p]) cairo_surface_destroy(set->bitmap[i][p]);
+	set->bitmap[i][p] = NULL;
+    }
+    set->size = 0;
+}
+
 void
 CreatePNGPieces ()
-{
-  int p;
+{ // select the set of scaled pieces for the current size and colors; they are only made when needed
+  static int clock;
+  unsigned int scheme = appData.monoMode + 2*appData.trueColors;
+  char *p;
+  int i;
 
-  for(p=0; pngPieceNames[p]; p++) {
-    ScaleOnePiece(0, p);
-    ScaleOnePiece(1, p);
+  FlushTileCache();
+  for(p=appData.whitePieceColor; *p; p++) scheme = 31*scheme + *p;
+  for(p=appData.blackPieceColor; *p; p++) scheme = 31*scheme + *p;
+  for(p=appData.pieceDirectory; *p; p++) scheme = 31*scheme + *p;
+  for(i=0; i<PIECE_SETS; i++) if(pieceSets[i].size == squareSize && pieceSets[i].scheme == scheme) break;
+  if(i == PIECE_SETS) { // not yet used: recycle least-recently used set
+    for(i=0; i<PIECE_SETS; i++) if(pieceSets[i].age < pieceSet->age) pieceSet = &pieceSets[i];
+    i = pieceSet - pieceSets;
+    FlushPieceSet(pieceSet);
+    pieceSet->size = squareSize; pieceSet->scheme = scheme;
   }
+  pieceSet = &pieceSets[i];
+  pieceSet->age = ++clock;
   SelectPieces(gameInfo.variant);
 }
 
@@ -416,6 +501,7 @@ void
 CreateAnyPieces (int p)
 {   // [HGM] taken out of main
     if(p) CreatePNGPieces();
+    FlushTileCache();
     CreatePNGBoard(appData.liteBackTextureFile, 1);
     CreatePNGBoard(appData.darkBackTextureFile, 0);
 }
@@ -424,12 +510,14 @@ void
 InitDrawingParams (int reloadPieces)
 {
     int i, p;
-    if(reloadPieces)
-    for(i=0; i<2; i++) for(p=0; p<BlackPawn+4; p++) {
+    if(reloadPieces) {
+      for(i=0; i<2; i++) for(p=0; p<BlackPawn+4; p++) {
 	if(pngPieceImages[i][p]) cairo_surface_destroy(pngPieceImages[i][p]);
 	pngPieceImages[i][p] = NULL;
 	if(svgPieces[i][p]) rsvg_handle_close(svgPieces[i][p], NULL);
 	svgPieces[i][p] = NULL;
+      }
+      for(i=0; i<PIECE_SETS; i++) FlushPieceSet(&pieceSets[i]); // scaled from the old images
     }
     CreateAnyPieces(1);
 }
@@ -683,10 +771,12 @@ BlankSquare (cairo_surface_t *dest, int x, int y, int color, ChessSquare piece,
 }
 
 static void
-pngDrawPiece (cairo_surface_t *dest, ChessSquare piece, int square_color, int x, int y)
+pngDrawPiece (cairo_surface_t *dest, ChessSquare piece, int square_color, int x, int y, int fac)
 {
     int kind;
     cairo_t *cr;
+    cairo_surface_t *bitmap;
+    RsvgHandle *svg;
 
     if ((int)piece < (int) BlackPawn) {
 	kind = 0;
@@ -695,10 +785,20 @@ pngDrawPiece (cairo_surface_t *dest, ChessSquare piece, int square_color, int x,
 	piece -= BlackPawn;
     }
     if(appData.upsideDown && flipView) kind = 1 - kind; // swap white and black pieces
-    BlankSquare(dest, x, y, square_color, piece, 1); // erase previous contents with background
+    BlankSquare(dest, x, y, square_color, piece, fac); // erase previous contents with background
+    bitmap = PieceBitmap(kind, piece); // this also loads the vector image, if there is one
+    svg = svgPieces[kind][pieceImageNr[piece]];
     cr = cairo_create (dest);
-    cairo_set_source_surface (cr, pngPieceBitmaps[kind][piece], x, y);
-    cairo_paint(cr);
+    if(vectorDiagram && svg && appData.trueColors && *appData.pieceDirectory) { // not recolored: SVG can use the vectors
+	RsvgDimensionData dim;
+	rsvg_handle_get_dimensions(svg, &dim);
+	cairo_translate(cr, x*fac, y*fac);
+	cairo_scale(cr, squareSize/(double) dim.width, squareSize/(double) dim.height);
+	rsvg_handle_render_cairo(svg, cr);
+    } else {
+	cairo_set_source_surface (cr, bitmap, x*fac, y*fac);
+	cairo_paint(cr);
+    }
     cairo_destroy (cr);
 }
 
@@ -731,13 +831,13 @@ DrawDot (int marker, int x, int y, int r)
 }
 
 static void
-DrawText (char *string, int x, int y, int align)
+DrawText (cairo_surface_t *dest, char *string, int x, int y, int align)
 {
 	int xx = x, yy = y;
 	cairo_text_extents_t te;
 	cairo_t *cr;
 
-	cr = cairo_create (csBoardWindow);
+	cr = cairo_create (dest);
 	cairo_select_font_face (cr, "Sans",
 		    CAIRO_FONT_SLANT_NORMAL,
 		    CAIRO_FONT_WEIGHT_BOLD);
@@ -769,7 +869,7 @@ DrawText (char *string, int x, int y, int align)
 }
 
 void
-InscribeKanji (ChessSquare piece, int x, int y)
+InscribeKanji (cairo_surface_t *dest, ChessSquare piece, int x, int y)
 {
     char *p, *q, buf[10];
     int n;
@@ -790,29 +890,77 @@ InscribeKanji (ChessSquare piece, int x, int y)
     strncpy(buf, p, 10);
     for(q=buf; (*++q & 0xC0) == 0x80;);
     *q = NULLCHAR;
-    DrawText(buf, x, y, n > WhiteLion ? -2 : -1);
+    DrawText(dest, buf, x, y, n > WhiteLion ? -2 : -1);
 }
 
-void
-DrawOneSquare (int x, int y, ChessSquare piece, int square_color, int marker, char *tString, char *bString, int align)
-{   // basic front-end board-draw function: takes care of everything that can be in square:
-    // piece, background, coordinate/count, marker dot
+static void
+ComposeSquare (cairo_surface_t *dest, int x, int y, int fac, ChessSquare piece, int square_color, int marker, char *tString, char *bString, int align)
+{   // draw all that is in the square; with fac = 0 at (0,0) of dest, but with the background of (x,y)
+    int ox = x*fac, oy = y*fac;
 
     if (piece == EmptySquare) {
-	BlankSquare(csBoardWindow, x, y, square_color, piece, 1);
+	BlankSquare(dest, x, y, square_color, piece, fac);
     } else {
-	pngDrawPiece(csBoardWindow, piece, square_color, x, y);
-        if(appData.inscriptions[0]) InscribeKanji(piece, x, y);
+	pngDrawPiece(dest, piece, square_color, x, y, fac);
+        if(appData.inscriptions[0]) InscribeKanji(dest, piece, ox, oy);
     }
 
     if(align) { // square carries inscription (coord or piece count)
-	if(align > 1) DrawText(tString, x, y, align);       // top (rank or count)
-	if(bString && *bString) DrawText(bString, x, y, 1); // bottom (always lower right file ID)
+	if(align > 1) DrawText(dest, tString, ox, oy, align);       // top (rank or count)
+	if(bString && *bString) DrawText(dest, bString, ox, oy, 1); // bottom (always lower right file ID)
     }
 
     if(marker) { // print fat marker dot, if requested
-	DoDrawDot(csBoardWindow, marker, x + squareSize/4, y+squareSize/4, squareSize/2);
+	DoDrawDot(dest, marker, ox + squareSize/4, oy+squareSize/4, squareSize/2);
+    }
+}
+
+void
+DrawOneSquare (int x, int y, ChessSquare piece, int square_color, int marker, char *tString, char *bString, int align)
+{   // basic front-end board-draw function: takes care of everything that can be in square:
+    // piece, background, coordinate/count, marker dot
+    char *top = (align > 1 && tString ? tString : ""), *bottom = (align && bString ? bString : ""), *p;
+    cairo_surface_t *bitmap = NULL;
+    SquareTile *t;
+    cairo_t *cr;
+    int x0, y0, kind;
+    unsigned int h;
+
+    if(strlen(top) >= sizeof(t->top) || strlen(bottom) >= sizeof(t->bottom) // too unusual to keep
+       || vectorDiagram) { // or tiles would paste bitmaps into an SVG diagram
+	ComposeSquare(csBoardWindow, x, y, 1, piece, square_color, marker, tString, bString, align);
+	return;
+    }
+    if(tileSize != squareSize) FlushTileCache();
+
+    // identify the tile: texture cell, piece image, and what is drawn on top of it
+    if(!((useTexture & square_color+1) && CutOutSquare(x, y, &x0, &y0, square_color))) x0 = y0 = -1;
+    if(piece != EmptySquare) {
+	kind = !White(piece);
+	if(appData.upsideDown && flipView) kind = 1 - kind;
+	bitmap = PieceBitmap(kind, piece % BlackPawn);
+    }
+    h = piece*977 + square_color*131 + marker*37 + align*7 + x0*5 + y0*1009;
+    for(p=top; *p; p++) h = 31*h + *p;
+    for(p=bottom; *p; p++) h = 31*h + *p;
+    t = &tileCache[(h ^ h>>9) & (TILE_CACHE-1)];
+
+    if(!t->tile || t->bitmap != bitmap || t->piece != piece || t->color != square_color || t->x0 != x0 || t->y0 != y0 ||
+       t->marker != marker || t->align != align || strcmp(t->top, top) || strcmp(t->bottom, bottom)) {
+	if(t->tile) cairo_surface_destroy(t->tile);
+	t->tile = cairo_image_surface_create (CAIRO_FORMAT_ARGB32, squareSize, squareSize);
+	ComposeSquare(t->tile, x, y, 0, piece, square_color, marker, tString, bString, align);
+	t->bitmap = bitmap; t->piece = piece; t->color = square_color; t->x0 = x0; t->y0 = y0;
+	t->marker = marker; t->align = align;
+	strcpy(t->top, top); strcpy(t->bottom, bottom);
     }
+
+    cr = cairo_create (csBoardWindow);
+    cairo_set_source_surface (cr, t->tile, x, y);
+    cairo_set_antialias (cr, CAIRO_ANTIALIAS_NONE);
+    cairo_rectangle (cr, x, y, squareSize, squareSize);
+    cairo_fill (cr);
+    cairo_destroy (cr);
 }
 
 /****	Animation code by Hugh Fisher, DCS, ANU. ****/
@@ -847,7 +995,7 @@ CairoOverlayPiece (ChessSquare piece, cairo_surface_t *dest)
 {
   static cairo_t *pieceSource;
   pieceSource = cairo_create (dest);
-  cairo_set_source_surface (pieceSource, pngPieceBitmaps[!White(piece)][piece % BlackPawn], 0, 0);
+  cairo_set_source_surface (pieceSource, PieceBitmap(!White(piece), piece % BlackPawn), 0, 0);
   if(doubleClick) cairo_paint_with_alpha (pieceSource, 0.6);
   else cairo_paint(pieceSource);
   cairo_destroy (pieceSource);
@@ -1017,3 +1165,119 @@ DrawEvalText (char *buf, int cbBuf, int y)
   /* free memory */
   cairo_destroy (cr);
 }
+
+// [HGM] incremental: front-end copy of the graph, from which the back-end can continue painting
+static cairo_surface_t *graphCopy;
+static int copyWidth, copyHeight;
+
+static void
+CopySurface (cairo_surface_t *dst, cairo_surface_t *src)
+{
+  cairo_t *cr = cairo_create(dst);
+  cairo_set_source_surface(cr, src, 0, 0);
+  cairo_paint(cr);
+  cairo_destroy(cr);
+}
+
+void
+SaveEvalGraph ()
+{
+  if(graphCopy && (copyWidth != nWidthPB || copyHeight != nHeightPB)) cairo_surface_destroy(graphCopy), graphCopy = NULL;
+  if(!graphCopy) graphCopy = cairo_surface_create_similar(DRAWABLE(disp), CAIRO_CONTENT_COLOR_ALPHA, copyWidth = nWidthPB, copyHeight = nHeightPB);
+  CopySurface(graphCopy, DRAWABLE(disp));
+}
+
+int
+RestoreEvalGraph ()
+{
+  if(!graphCopy || copyWidth != nWidthPB || copyHeight != nHeightPB) return FALSE;
+  CopySurface(DRAWABLE(disp), graphCopy);
+  return TRUE;
+}
+
+/* [HGM] diagram: the board can also be drawn off-screen, to save positions as images
+   without any window. The drawing code is the same as for the display, and just
+   draws on an image (or SVG) surface instead of the board widget. In SVG the squares,
+   grid and text are vectors, and so are the pieces if they are SVG images that need
+   no recoloring; board textures and other pieces can only be embedded as bitmaps.	*/
+
+int
+WriteDiagram (char *name, Board board)
+{   // draw the position on an off-screen surface and save that as PNG or SVG file
+    int w = lineGap + BOARD_WIDTH * (squareSize + lineGap), h = lineGap + BOARD_HEIGHT * (squareSize + lineGap);
+    char *ext = strrchr(name, '.');
+    int svg = ext && !StrCaseCmp(ext, ".svg"), ok;
+    cairo_surface_t *cs, *save = csBoardWindow;
+
+    cs = svg ? cairo_svg_surface_create(name, w, h) : cairo_image_surface_create(CAIRO_FORMAT_ARGB32, w, h);
+    csBoardWindow = cs; vectorDiagram = svg;
+    DrawDiagram(board);
+    csBoardWindow = save; vectorDiagram = FALSE;
+    if(svg) cairo_surface_finish(cs), ok = cairo_surface_status(cs) == CAIRO_STATUS_SUCCESS;
+    else ok = cairo_surface_write_to_png(cs, name) == CAIRO_STATUS_SUCCESS;
+    cairo_surface_destroy(cs);
+    return ok;
+}
+
+static int
+DiagramPattern (char *p)
+{   // -diagramFile is used as printf format, so it must contain a single integer conversion, like %d or %04d
+    int n = 0;
+    while((p = strchr(p, '%'))) {
+	if(*++p == '%') { p++; continue; }
+	while(*p >= '0' && *p <= '9') p++;
+	if(*p++ != 'd') return FALSE;
+	n++;
+    }
+    return n == 1;
+}
+
+int
+SaveDiagrams ()
+{   // headless batch: write a diagram for every FEN in the position file, divided over several processes
+    FILE *f;
+    char line[MSG_SIZ], name[MSG_SIZ], **fens = NULL;
+    int n, nr = 0, size = 0, job, jobs = appData.diagramJobs, bad = 0, status;
+
+    if(!DiagramPattern(appData.diagramFile)) {
+	fprintf(stderr, _("%s: diagram file name '%s' must contain one %%d\n"), programName, appData.diagramFile);
+	return 1;
+    }
+    if(!*appData.loadPositionFile || (f = fopen(appData.loadPositionFile, "r")) == NULL) {
+	fprintf(stderr, _("%s: cannot open position file '%s'\n"), programName, appData.loadPositionFile);
+	return 1;
+    }
+    // read all positions before forking: the workers would otherwise share (and fight over) the file offset
+    while(fgets(line, MSG_SIZ, f)) {
+	if(line[0] == '\n' || line[0] == '#') continue; // blank lines and comments do not count
+	if(nr >= size) fens = realloc(fens, (size = 2*size + 64) * sizeof(char *));
+	fens[nr++] = strdup(line);
+    }
+    fclose(f);
+    if(jobs < 1) jobs = 1;
+    flipView = appData.flipView;
+    CreateGrid();
+    CreateAnyPieces(1);
+
+    for(job=1; job<jobs; job++) if(fork() == 0) break; // child renders every jobs-th position, starting at job
+    if(job == jobs) job = 0;                           // parent does its own share
+
+    for(n=job; n<nr; n+=jobs) {
+	Board board;
+	int blackPlaysFirst;
+	snprintf(name, MSG_SIZ, appData.diagramFile, n+1);
+	if(!ParseFEN(board, &blackPlaysFirst, fens[n], FALSE)) {
+	    fprintf(stderr, _("%s: bad FEN for diagram %s\n"), programName, name);
+	    bad++;
+	} else if(!WriteDiagram(name, board)) {
+	    fprintf(stderr, _("%s: cannot write diagram %s\n"), programName, name);
+	    bad++;
+	}
+    }
+
+    if(job) _exit(bad != 0); // not exit(): that would flush stdio buffers copied from the parent once more
+    while(wait(&status) > 0) if(!WIFEXITED(status) || WEXITSTATUS(status)) bad++;
+    for(n=0; n<nr; n++) free(fens[n]);
+    free(fens);
+    return bad != 0;
+}
@@ -67,6 +67,8 @@ void CreateGrid P((void));
 void DrawSegment P((int x, int y, int *lastX, int *lastY, int p));
 void DrawRectangle P((int left, int top, int right, int bottom, int side, int style));
 void DrawEvalText P((char *buf, int cbBuf, int y));
+int WriteDiagram P((char *name, Board board));
+int SaveDiagrams P((void));
 extern Option *disp;
 extern char svgDir[];
 
@@ -159,18 +159,154 @@ SetEngineState (int which, enum ENGINE_STATE state, char * state_data)
     }
 }
 
-// back end, now the front-end wrapper ClearMemo is used, and ed no longer contains handles.
-void
-SetProgramStats (FrontEndProgramStats * stats) // now directly called by back-end
-{
+/* [HGM] rate: engines can send thousands of lines per second, far more than anyone can read,
+   and each of them used to be parsed and inserted into the memo widget. Lines are now collected,
+   and shown at most every EO_INTERVAL msec. Until then a newer line for the same depth and first
+   move replaces the one still waiting, so only the lines that would remain visible get drawn. */
+
+#define EO_INTERVAL 100
+#define MAX_PENDING 32
+
+typedef struct {
     EngineOutputData ed;
+    int fmm, cm; // position the line was about
+    char pv[MSG_SIZ], hint[64];
+} PendingStats;
+
+static PendingStats pending[2][MAX_PENDING];
+static int nrPending[2];
+static TimeMark lastFlush;
+
+static char *
+PVStart (char *pv)
+{   // [HGM] tbhits: skip extra infos in front of the real PV
+    char *q;
+    if(pv) {
+        while(strchr(pv, '\t')) { // locate last tab before non-int (real PV starts after that)
+            for(q=pv; isdigit(*q) || *q == ' '; q++);
+            if(*q != '\t') break;
+            pv = q + 1;
+        }
+    }
+    return pv;
+}
+
+static int
+SameVariation (EngineOutputData *ed1, EngineOutputData *ed2)
+{   // lines of same depth starting with same move; info lines are never the same
+    char *p = PVStart(ed1->pv), *q = PVStart(ed2->pv);
+    if(ed1->depth != ed2->depth || !*p) return FALSE;
+    if(ed1->nodes == 0 && ed1->score == 0 && ed1->time == 0) return FALSE;
+    if(ed2->nodes == 0 && ed2->score == 0 && ed2->time == 0) return FALSE;
+    while(*p && *p != ' ' && *p == *q) p++, q++;
+    return (*p == ' ' || !*p) && (*q == ' ' || !*q);
+}
+
+static void
+ShowProgramStats (PendingStats *p)
+{
+    EngineOutputData *ed = &p->ed;
     int clearMemo = FALSE;
-    int which, depth, multi;
+    int which = ed->which, depth = ed->depth, multi;
     ChessMove moveType;
     int ff, ft, rf, rt;
     char pc;
 
+    /* Clear memo if needed */
+    if( lastDepth[which] > depth || (lastDepth[which] == depth && depth <= 1 && ed->pv[0]) ) { // no reason to clear if we won't add line
+        clearMemo = TRUE;
+    }
+
+    if( lastForwardMostMove[which] != p->fmm ) {
+        clearMemo = TRUE;
+    }
+
+    if( clearMemo ) {
+        if(!appData.headers) columnHeader[0] = NULLCHAR;
+        DoClearMemo(which); nrVariations[which] = 0;
+        header[which][0] = NULLCHAR;
+        if(gameMode == AnalyzeMode) {
+          ChessProgramState *cps = (which ? &second : &first);
+          if((multi = MultiPV(cps)) >= 0) {
+            snprintf(header[which], MSG_SIZ, "\t%s viewpoint\t\tfewer / Multi-PV setting = %d / more\n",
+                                       appData.whitePOV || appData.scoreWhite ? "white" : "mover", cps->option[multi].value);
+	  }
+          if(!which) snprintf(header[which]+strlen(header[which]), MSG_SIZ-strlen(header[which]), "%s%s", exclusionHeader, columnHeader);
+          InsertIntoMemo( which, header[which], 0);
+        } else {
+          snprintf(header[which], MSG_SIZ, "%s", columnHeader);
+          if(appData.ponderNextMove && lastLine[which][0]) {
+            InsertIntoMemo( which, lastLine[which], 0 );
+            InsertIntoMemo( which, "\n", 0 );
+          }
+          InsertIntoMemo( which, header[which], 0);
+        }
+    }
+
+    if(ed->pv && ed->pv[0] && ParseOneMove(ed->pv, p->cm, &moveType, &ff, &rf, &ft, &rt, &pc))
+	ed->moveKey = (ff<<24 | rf << 16 | ft << 8 | rt) ^ pc*87161;
+    else ed->moveKey = ed->nodes; // kludge to get unique key unlikely to match any move
+
+    /* Update */
+    lastDepth[which] = depth == 1 && ed->nodes == 0 ? 0 : depth; // [HGM] info-line kudge
+    lastForwardMostMove[which] = p->fmm;
+
+    UpdateControls( ed );
+}
+
+void
+FlushEngineOutput ()
+{   // show all lines collected since last time
+    int n, i;
+
+    GetTimeMark(&lastFlush);
+    for(n=0; n<2; n++) {
+	if(EngineOutputDialogExists())
+	    for(i=0; i<nrPending[n]; i++) ShowProgramStats(&pending[n][i]);
+	nrPending[n] = 0;
+    }
+}
+
+static void
+QueueProgramStats (EngineOutputData *ed)
+{
+    int n = ed->which, i, depth = ed->depth;
+    PendingStats *p;
+
+    // a line waiting for the same variation in the same search is replaced
+    for(i=nrPending[n]-1; i>=0; i--) {
+	p = &pending[n][i];
+	if(p->fmm != forwardMostMove || p->ed.depth > depth) break; // earlier search, which would be cleared anyway
+	depth = p->ed.depth;
+	if(SameVariation(&p->ed, ed)) {
+	    memmove(p, p + 1, (nrPending[n] - i - 1) * sizeof(PendingStats));
+	    nrPending[n]--;
+	    break;
+	}
+    }
+
+    if(nrPending[n] == MAX_PENDING) FlushEngineOutput();
+    p = &pending[n][nrPending[n]++];
+    p->ed = *ed;
+    p->fmm = forwardMostMove;
+    p->cm = currentMove;
+    safeStrCpy(p->pv, ed->pv, MSG_SIZ);
+    safeStrCpy(p->hint, ed->hint ? ed->hint : "", sizeof(p->hint));
+    p->ed.pv = p->pv;
+    p->ed.hint = p->hint;
+}
+
+// back end, now the front-end wrapper ClearMemo is used, and ed no longer contains handles.
+void
+SetProgramStats (FrontEndProgramStats * stats) // now directly called by back-end
+{
+    EngineOutputData ed;
+    int which, depth;
+    TimeMark now;
+    long elapsed;
+
     if( stats == 0 ) {
+        FlushEngineOutput(); // lines of the search that just ended go first
         SetEngineState( 0, STATE_IDLE, "" );
         SetEngineState( 1, STATE_IDLE, "" );
         return;
@@ -216,46 +352,13 @@ SetProgramStats (FrontEndProgramStats * stats) // now directly called by back-en
         }
     }
 
-    /* Clear memo if needed */
-    if( lastDepth[which] > depth || (lastDepth[which] == depth && depth <= 1 && ed.pv[0]) ) { // no reason to clear if we won't add line
-        clearMemo = TRUE;
-    }
+    QueueProgramStats( &ed );
 
-    if( lastForwardMostMove[which] != forwardMostMove ) {
-        clearMemo = TRUE;
-    }
-
-    if( clearMemo ) {
-        if(!appData.headers) columnHeader[0] = NULLCHAR;
-        DoClearMemo(which); nrVariations[which] = 0;
-        header[which][0] = NULLCHAR;
-        if(gameMode == AnalyzeMode) {
-          ChessProgramState *cps = (which ? &second : &first);
-          if((multi = MultiPV(cps)) >= 0) {
-            snprintf(header[which], MSG_SIZ, "\t%s viewpoint\t\tfewer / Multi-PV setting = %d / more\n",
-                                       appData.whitePOV || appData.scoreWhite ? "white" : "mover", cps->option[multi].value);
-	  }
-          if(!which) snprintf(header[which]+strlen(header[which]), MSG_SIZ-strlen(header[which]), "%s%s", exclusionHeader, columnHeader);
-          InsertIntoMemo( which, header[which], 0);
-        } else {
-          snprintf(header[which], MSG_SIZ, "%s", columnHeader);
-          if(appData.ponderNextMove && lastLine[which][0]) {
-            InsertIntoMemo( which, lastLine[which], 0 );
-            InsertIntoMemo( which, "\n", 0 );
-          }
-          InsertIntoMemo( which, header[which], 0);
-        }
-    }
-
-    if(ed.pv && ed.pv[0] && ParseOneMove(ed.pv, currentMove, &moveType, &ff, &rf, &ft, &rt, &pc))
-	ed.moveKey = (ff<<24 | rf << 16 | ft << 8 | rt) ^ pc*87161;
-    else ed.moveKey = ed.nodes; // kludge to get unique key unlikely to match any move
-
-    /* Update */
-    lastDepth[which] = depth == 1 && ed.nodes == 0 ? 0 : depth; // [HGM] info-line kudge
-    lastForwardMostMove[which] = forwardMostMove;
-
-    UpdateControls( &ed );
+    /* [HGM] rate: show at once if the pane was not updated recently, otherwise when interval is over */
+    GetTimeMark(&now);
+    elapsed = SubtractTimeMarks(&now, &lastFlush);
+    if(elapsed >= EO_INTERVAL || elapsed < 0) FlushEngineOutput();
+    else if(!EngineOutputTimerRunning()) StartEngineOutputTimer(EO_INTERVAL - elapsed);
 }
 
 #define ENGINE_COLOR_WHITE      'w'
@@ -469,7 +572,7 @@ UpdateControls (EngineOutputData *ed)
     char s_label[MAX_NAME_LENGTH + 32];
     int h;
     char * name = ed->name;
-    char *q, *pvStart = ed->pv;
+    char *pvStart = PVStart(ed->pv);
 
     /* Label */
     if( name == 0 || *name == '\0' ) {
@@ -479,14 +582,6 @@ UpdateControls (EngineOutputData *ed)
     strncpy( s_label, name, MAX_NAME_LENGTH );
     s_label[ MAX_NAME_LENGTH-1 ] = '\0';
 
-    if(pvStart) { // [HGM] tbhits: plit up old PV into extra infos and real PV
-        while(strchr(pvStart, '\t')) { // locate last tab before non-int (real PV starts after that)
-            for(q=pvStart; isdigit(*q) || *q == ' '; q++);
-            if(*q != '\t') break;
-            pvStart = q + 1;
-        }
-    }
-
 #ifdef SHOW_PONDERING
     if( IsEnginePondering( ed->which ) ) {
         char buf[12];
@@ -70,16 +70,6 @@ DrawLine (int x1, int y1, int x2, int y2, int penType)
     DrawSegment( x2, y2, NULL, NULL, penType );
 }
 
-// back-end
-static void
-DrawLineEx (int x1, int y1, int x2, int y2, int penType)
-{
-    int savX, savY;
-    DrawSegment( x1, y1, &savX, &savY, PEN_NONE );
-    DrawSegment( x2, y2, NULL, NULL, penType );
-    DrawSegment( savX, savY, NULL, NULL, PEN_NONE );
-}
-
 // back-end
 static int
 GetPvScore (int index)
@@ -197,83 +187,88 @@ DrawHistogram (int x, int y, int width, int value, int side)
     }
 }
 
+/* [HGM] incremental: the front-end keeps a copy of the graph without the current-move marker
+   (SaveEvalGraph/RestoreEvalGraph). Here we record what that copy shows, so that adding a move
+   only has to draw the new bar or line segment, and stepping through the game only the marker. */
+static struct {
+    int valid;
+    int width, height, zoom, threshold, range, differential;
+    int first, last;
+    int diagram;              // plies drawn as lines rather than bars
+    double perPly;            // horizontal pixels per ply
+    int lastX[2], lastY[2];   // end of the line of each side (diagram)
+    int colMin[2], colMax[2]; // vertical extent already drawn in column lastX (diagram)
+    int sepX;                 // column of the last separator drawn
+} painted;
+
+static int paintedScore[MAX_MOVES];
+static char paintedDepth[MAX_MOVES];
+
+// back-end
+static int
+IndexX (int index)
+{
+    if( painted.diagram ) return MarginX + MarginW + (int) ((index - currFirst) * painted.perPly);
+    return MarginX + MarginW + index * (int) painted.perPly;
+}
+
 // back-end
 static void
 DrawSeparator (int index, int x)
 {
-    if( index > 0 ) {
-        if( index == currCurrent ) {
-            DrawLineEx( x, MarginH, x, nHeightPB - MarginH, PEN_BLUEDOTTED );
-        }
-        else if( (index % 20) == 0 ) {
-            DrawLineEx( x, MarginH, x, nHeightPB - MarginH, PEN_DOTTED );
-        }
+    /* Draw a separator every 10 moves, but only one per pixel column */
+    if( index > 0 && (index % 20) == 0 && x != painted.sepX ) {
+        DrawLine( x, MarginH, x, nHeightPB - MarginH, PEN_DOTTED );
+        painted.sepX = x;
     }
 }
 
-// made back-end by replacing MoveToEx and LineTo by DrawSegment
-/* Actually draw histogram as a diagram, cause there's too much data */
+// back-end: the current move is drawn over the cached graph, so it can move without repainting
 static void
-DrawHistogramAsDiagram (int cy, int paint_width, int hist_count)
+DrawMarker ()
 {
-    double step;
-    int i;
-
-    /* Rescale the graph every few moves (as opposed to every move) */
-    hist_count -= hist_count % 8;
-    hist_count += 8;
-    hist_count /= 2;
-
-    step = (double) paint_width / (hist_count + 1);
-
-    for( i=0; i<2; i++ ) {
-        int index = currFirst;
-        int side = (currCurrent + i + 1) & 1; /* Draw current side last */
-        double x = MarginX + MarginW;
-
-        if( (index & 1) != side ) {
-            x += step / 2;
-            index++;
-        }
-
-        DrawSegment( (int) x, cy, NULL, NULL, PEN_NONE );
-
-        index += 2;
-
-        while( index < currLast ) {
-            x += step;
-
-            DrawSeparator( index, (int) x );
-
-            /* Extend line up to current point */
-            if( currPvInfo[index].depth > 0 ) {
-	      DrawSegment((int) x, GetValueY( GetPvScore(index) ), NULL, NULL, (side==0 ? PEN_BOLDWHITE: PEN_BOLDBLACK) );
-            }
-
-            index += 2;
-        }
+    if( currCurrent > 0 && currCurrent < currLast ) {
+        int x = IndexX( currCurrent );
+        DrawLine( x, MarginH, x, nHeightPB - MarginH, PEN_BLUEDOTTED );
     }
 }
 
-// back-end, delete pen selection
+// made back-end by replacing MoveToEx and LineTo by DrawSegment
+/* Actually draw histogram as a diagram, cause there's too much data.
+   [HGM] decimation: plies that fall in the same pixel column only widen the vertical extent drawn there */
 static void
-DrawHistogramFull (int cy, int hist_width, int hist_count)
+ExtendDiagram (int side, int x, int y)
 {
-    int i;
+    int pen = (side == 0 ? PEN_BOLDWHITE : PEN_BOLDBLACK);
+
+    if( x == painted.lastX[side] ) {
+        if( y < painted.colMin[side] ) DrawLine( x, painted.colMin[side], x, y, pen ), painted.colMin[side] = y;
+        if( y > painted.colMax[side] ) DrawLine( x, painted.colMax[side], x, y, pen ), painted.colMax[side] = y;
+    } else {
+        /* Extend line up to current point */
+        DrawLine( painted.lastX[side], painted.lastY[side], x, y, pen );
+        painted.colMin[side] = painted.colMax[side] = y;
+    }
+    painted.lastX[side] = x; painted.lastY[side] = y;
+}
 
-//    SelectObject( hdcPB, GetStockObject(BLACK_PEN) );
+// back-end: draw a single ply on top of what is already there
+static void
+DrawPly (int index, int cy)
+{
+    int x = IndexX( index );
 
-    for( i=0; i<hist_count; i++ ) {
-        int index = currFirst + i;
-        int x = MarginX + MarginW + index * hist_width;
+    DrawSeparator( index, x );
 
-        /* Draw a separator every 10 moves */
-        DrawSeparator( index, x );
+    paintedScore[index] = currPvInfo[index].score;
+    paintedDepth[index] = currPvInfo[index].depth > 0;
+    if( currPvInfo[index].depth <= 0 ) return;
 
-        /* Draw histogram */
-        if( currPvInfo[i].depth > 0 ) {
-            DrawHistogram( x, cy, hist_width, GetPvScore(index), index & 1 );
-        }
+    if( !painted.diagram ) {
+        DrawHistogram( x, cy, (int) painted.perPly, GetPvScore(index), index & 1 );
+    }
+    else if( index >= currFirst + 2 ) { // first ply of each side is the starting point of its line
+        ExtendDiagram( index & 1, x, GetValueY( GetPvScore(index) ) );
     }
 }
 
@@ -309,57 +304,69 @@ InitVisualization (VisualizationData *vd)
     return result;
 }
 
-// back-end
+// back-end: start a full repaint of the plies
 static void
-DrawHistograms ()
+StartHistograms (int cy)
 {
-    VisualizationData vd;
-    int i; double step = 1;
+    int i;
 
-    if( InitVisualization( &vd ) ) {
-        if( vd.hist_width < MIN_HIST_WIDTH ) {
-            DrawHistogramAsDiagram( vd.cy, vd.paint_width, vd.hist_count );
-            step = 0.5*vd.paint_width / (((vd.hist_count | 7) + 1)/2 + 1.);
-        }
-        else {
-            DrawHistogramFull( vd.cy, step = vd.hist_width, vd.hist_count );
-        }
+    painted.last = currFirst;
+    painted.sepX = -1;
+
+    for( i=0; i<2; i++ ) { // the lines of both sides start on the axis
+        int index = currFirst + ((currFirst ^ i) & 1);
+        painted.lastX[i] = IndexX( index );
+        painted.lastY[i] = painted.colMin[i] = painted.colMax[i] = cy;
     }
-    if(!differentialView) return;
+}
+
+// back-end: the blunder graph depends on the next ply too, so it is only drawn in full
+static void
+DrawDifferential (int cy)
+{
+    int i;
+
     differentialView = 0;
-    DrawSegment( MarginX + MarginW, vd.cy, NULL, NULL, PEN_NONE );
-    for( i=0; i<vd.hist_count; i++ ) {
-        int index = currFirst + i;
-        int x = MarginX + MarginW + index * step + step/2;
-        DrawSegment((int) x, GetValueY( GetPvScore(index) ), NULL, NULL, PEN_ANY );
+    DrawSegment( MarginX + MarginW, cy, NULL, NULL, PEN_NONE );
+    for( i=currFirst; i<currLast; i++ ) {
+        DrawSegment( IndexX( i ) + (int) painted.perPly/2, GetValueY( GetPvScore(i) ), NULL, NULL, PEN_ANY );
     }
     differentialView = 1;
 }
 
+// back-end: test whether the cached graph can be extended to show the current data
+static Boolean
+SameLayout (int diagram, double perPly)
+{
+    int i;
+
+    if( !painted.valid || painted.width != nWidthPB || painted.height != nHeightPB || painted.zoom != appData.zoom ||
+        painted.threshold != appData.evalThreshold || painted.range != range || painted.differential != differentialView ||
+        painted.first != currFirst || painted.last > currLast || painted.diagram != diagram || painted.perPly != perPly ) return FALSE;
+
+    if( differentialView && painted.last != currLast ) return FALSE; // each new score changes the previous bar
+
+    for( i=currFirst; i<painted.last; i++ ) { // scores already drawn must not have changed
+        if( paintedScore[i] != currPvInfo[i].score || paintedDepth[i] != (currPvInfo[i].depth > 0) ) return FALSE;
+    }
+
+    return TRUE;
+}
+
 // back-end
 int
 GetMoveIndexFromPoint (int x, int y)
 {
     int result = -1;
     int start_x = MarginX + MarginW;
-    VisualizationData vd;
-
-    if( x >= start_x && InitVisualization( &vd ) ) {
-        /* Almost an hack here... we duplicate some of the paint logic */
-        if( vd.hist_width < MIN_HIST_WIDTH ) {
-            double step;
-
-            vd.hist_count -= vd.hist_count % 8;
-            vd.hist_count += 8;
-            vd.hist_count /= 2;
 
-            step = (double) vd.paint_width / (vd.hist_count + 1);
-            step /= 2;
-
-            result = (int) (0.5 + (double) (x - start_x) / step);
+    /* [HGM] incremental: use the layout of what was last painted */
+    if( x >= start_x && painted.valid && currLast > currFirst ) {
+        if( painted.diagram ) {
+            result = currFirst + (int) (0.5 + (double) (x - start_x) / painted.perPly);
         }
         else {
-            result = (x - start_x) / vd.hist_width;
+            result = (x - start_x) / (int) painted.perPly;
         }
     }
 
@@ -374,10 +381,38 @@ GetMoveIndexFromPoint (int x, int y)
 void
 PaintEvalGraph (void)
 {
+    VisualizationData vd;
     VariantClass v = gameInfo.variant;
+    int i, diagram, dirty = FALSE;
+    double perPly;
+
     range = (gameInfo.holdingsWidth && v != VariantSuper && v != VariantGreat && v != VariantSChess) ? 2 : 1; // [HGM] double range in drop games
-    /* Draw */
-    DrawRectangle(0, 0, nWidthPB, nHeightPB, 2, FILLED);
-    DrawAxis();
-    DrawHistograms();
+
+    InitVisualization( &vd );
+    diagram = vd.hist_width < MIN_HIST_WIDTH;
+    /* Rescale the graph every few moves (as opposed to every move) */
+    perPly = diagram ? 0.5*vd.paint_width / (((vd.hist_count | 7) + 1)/2 + 1.) : vd.hist_width;
+
+    if( !SameLayout( diagram, perPly ) || !RestoreEvalGraph() ) { // full repaint
+        painted.valid = TRUE;
+        painted.width = nWidthPB; painted.height = nHeightPB; painted.zoom = appData.zoom;
+        painted.threshold = appData.evalThreshold; painted.range = range; painted.differential = differentialView;
+        painted.first = currFirst; painted.diagram = diagram; painted.perPly = perPly;
+
+        /* Draw */
+        DrawRectangle(0, 0, nWidthPB, nHeightPB, 2, FILLED);
+        DrawAxis();
+        StartHistograms( vd.cy );
+        dirty = TRUE;
+    }
+
+    if( painted.last < currLast ) { // only what was added since the last paint
+        for( i=painted.last; i<currLast; i++ ) DrawPly( i, vd.cy );
+        painted.last = currLast;
+        if( differentialView ) DrawDifferential( vd.cy );
+        dirty = TRUE;
+    }
+
+    if( dirty ) SaveEvalGraph();
+    DrawMarker();
 }
@@ -50,6 +50,8 @@ extern int MarginH;
 void DrawSegment( int x, int y, int *lastX, int *lastY, int p );
 void DrawRectangle( int left, int top, int right, int bottom, int side, int style );
 void DrawEvalText(char *buf, int cbBuf, int y);
+void SaveEvalGraph( void );    // keep a copy of the painted graph
+int RestoreEvalGraph( void );  // put it back, FALSE if there is none of the current size
 void EvalGraphSet P(( int first, int last, int current, ChessProgramStats_Move * pvInfo ));
 
 // calls of front-end part into back-end part
@@ -123,6 +123,12 @@ void UpdateLogos P((int display));
 int LoadGameTimerRunning P((void));
 int StopLoadGameTimer P((void));
 void StartLoadGameTimer P((long millisec));
+int OutputTimerRunning P((void));
+void StartOutputTimer P((long millisec));
+int AnimationTimerRunning P((void));
+void StartAnimationTimer P((long millisec));
+int EngineOutputTimerRunning P((void));
+void StartEngineOutputTimer P((long millisec));
 void AutoSaveGame P((void));
 
 void ScheduleDelayedEvent P((DelayedEventCallback cb, long millisec));
@@ -146,6 +152,7 @@ int OpenTelnet P((char *host, char *port, ProcRef *pr));
 int OpenTCP P((char *host, char *port, ProcRef *pr));
 int OpenCommPort P((char *name, ProcRef *pr));
 int OpenLoopback P((ProcRef *pr));
+int OpenReplay P((char *file, float speed, ProcRef *pr));
 int OpenRcmd P((char *host, char *user, char *cmd, ProcRef *pr));
 
 typedef void (*InputCallback) P((InputSourceRef isr, VOIDSTAR closure,
@@ -157,8 +164,6 @@ void RemoveInputSource P((InputSourceRef isr));
 
 /* pr == NoProc means the local display */
 int OutputToProcess P((ProcRef pr, char *message, int count, int *outError));
-int OutputToProcessDelayed P((ProcRef pr, char *message, int count,
-			      int *outError, long msdelay));
 
 void CmailSigHandlerCallBack P((InputSourceRef isr, VOIDSTAR closure,
 				char *buf, int count, int error));
@@ -203,6 +208,7 @@ void AnimateAtomicCapture P((Board board, int fromX, int fromY, int toX, int toY
 void ShutDownFrontEnd P((void));
 void BoardToTop P((void));
 void AnimateMove P((Board board, int fromX, int fromY, int toX, int toY));
+void AnimationTimerEvent P((void));
 void HistorySet P((char movelist[][2*MOVE_LEN], int first, int last, int current));
 void FreezeUI P((void));
 void ThawUI P((void));
@@ -228,6 +234,7 @@ typedef struct FrontEndProgramStats_TAG {
 } FrontEndProgramStats;
 
 void SetProgramStats P(( FrontEndProgramStats * stats )); /* [AS] */
+void FlushEngineOutput P((void));
 
 void EngineOutputPopUp P((void));
 void EngineOutputPopDown P((void));
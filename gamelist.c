@@ -58,7 +58,6 @@
  */
 List gameList;
 extern Board initialPosition;
-extern int quickFlag;
 extern int movePtr;
 
 /* Local function prototypes
@@ -67,6 +66,7 @@ static void GameListDeleteGame P((ListGame *));
 static ListGame *GameListCreate P((void));
 static void GameListFree P((List *));
 static int GameListNewGame P((ListGame **));
+static void FreeTagColumns P((void));
 
 /* [AS] Wildcard pattern matching */
 Boolean
@@ -153,6 +153,7 @@ GameListDeleteGame (ListGame *listGame)
 static void
 GameListFree (List *gameList)
 {
+  FreeTagColumns();
   while (!ListEmpty(gameList))
     {
 	GameListDeleteGame((ListGame *) gameList->head);
@@ -241,7 +242,7 @@ GameListBuild (FILE *f)
     do {
         yyboardindex = scratch;
 	offset = yyoffset();
-	quickFlag = plyNr + 1;
+	mainGen.quick = plyNr + 1;
 	cm = (ChessMove) Myylex();
 	switch (cm) {
 	  case GNUChessGame:
@@ -394,7 +395,7 @@ GameListBuild (FILE *f)
     }
   }
     if(appData.debugMode) { GetTimeMark(&t2);printf("GameListBuild %ld msec\n", SubtractTimeMarks(&t2,&t)); }
-    quickFlag = 0;
+    mainGen.quick = 0;
     PackGame(boards[scratch]); // for appending end-of-game marker.
     DisplayTitle("WinBoard");
     rewind(f);
@@ -466,6 +467,68 @@ GameListLineOld (int number, GameInfo *gameInfo)
 
 #define MAX_FIELD_LEN   80  /* To avoid overflowing the buffer */
 
+/* Put the text of one tag in buf, as it appears in the list line, and return its end */
+static char *
+GameListField (int tag, GameInfo * gameInfo, char * buf)
+{
+    switch( tag ) {
+    case GLT_EVENT:
+        strncpy( buf, gameInfo->event ? gameInfo->event : "?", MAX_FIELD_LEN );
+        break;
+    case GLT_SITE:
+        strncpy( buf, gameInfo->site ? gameInfo->site : "?", MAX_FIELD_LEN );
+        break;
+    case GLT_DATE:
+        strncpy( buf, gameInfo->date ? gameInfo->date : "?", MAX_FIELD_LEN );
+        break;
+    case GLT_ROUND:
+        strncpy( buf, gameInfo->round ? gameInfo->round : "?", MAX_FIELD_LEN );
+        break;
+    case GLT_PLAYERS:
+        strncpy( buf, gameInfo->white ? gameInfo->white : "?", MAX_FIELD_LEN );
+        buf[ MAX_FIELD_LEN-1 ] = '\0';
+        buf += strlen( buf );
+        *buf++ = '-';
+        strncpy( buf, gameInfo->black ? gameInfo->black : "?", MAX_FIELD_LEN );
+        break;
+    case GLT_RESULT:
+	    safeStrCpy( buf, PGNResult(gameInfo->result), 2*MSG_SIZ );
+        break;
+    case GLT_WHITE_ELO:
+        if( gameInfo->whiteRating > 0 )
+	      sprintf( buf,  "%d", gameInfo->whiteRating );
+        else
+	      safeStrCpy( buf, "?" , 2*MSG_SIZ);
+        break;
+    case GLT_BLACK_ELO:
+        if( gameInfo->blackRating > 0 )
+            sprintf( buf, "%d", gameInfo->blackRating );
+        else
+	      safeStrCpy( buf, "?" , 2*MSG_SIZ);
+        break;
+    case GLT_TIME_CONTROL:
+        strncpy( buf, gameInfo->timeControl ? gameInfo->timeControl : "?", MAX_FIELD_LEN );
+        break;
+    case GLT_VARIANT:
+        strncpy( buf, gameInfo->variantName ? gameInfo->variantName : VariantName(gameInfo->variant), MAX_FIELD_LEN );
+//            strncpy( buf, VariantName(gameInfo->variant), MAX_FIELD_LEN );
+        break;
+    case GLT_OUT_OF_BOOK:
+        strncpy( buf, gameInfo->outOfBook ? gameInfo->outOfBook : "?", MAX_FIELD_LEN );
+        break;
+    case GLT_RESULT_COMMENT:
+        strncpy( buf, gameInfo->resultDetails ? gameInfo->resultDetails : "res?", MAX_FIELD_LEN );
+        break;
+    default:
+        *buf = '\0';
+        break;
+    }
+
+    buf[MAX_FIELD_LEN-1] = '\0';
+
+    return buf + strlen( buf );
+}
+
 char *
 GameListLine (int number, GameInfo * gameInfo)
 {
@@ -478,61 +541,7 @@ GameListLine (int number, GameInfo * gameInfo)
     while( *glt != '\0' ) {
         *buf++ = ' ';
 
-        switch( *glt ) {
-        case GLT_EVENT:
-            strncpy( buf, gameInfo->event ? gameInfo->event : "?", MAX_FIELD_LEN );
-            break;
-        case GLT_SITE:
-            strncpy( buf, gameInfo->site ? gameInfo->site : "?", MAX_FIELD_LEN );
-            break;
-        case GLT_DATE:
-            strncpy( buf, gameInfo->date ? gameInfo->date : "?", MAX_FIELD_LEN );
-            break;
-        case GLT_ROUND:
-            strncpy( buf, gameInfo->round ? gameInfo->round : "?", MAX_FIELD_LEN );
-            break;
-        case GLT_PLAYERS:
-            strncpy( buf, gameInfo->white ? gameInfo->white : "?", MAX_FIELD_LEN );
-            buf[ MAX_FIELD_LEN-1 ] = '\0';
-            buf += strlen( buf );
-            *buf++ = '-';
-            strncpy( buf, gameInfo->black ? gameInfo->black : "?", MAX_FIELD_LEN );
-            break;
-        case GLT_RESULT:
-	    safeStrCpy( buf, PGNResult(gameInfo->result), 2*MSG_SIZ );
-            break;
-        case GLT_WHITE_ELO:
-            if( gameInfo->whiteRating > 0 )
-	      sprintf( buf,  "%d", gameInfo->whiteRating );
-            else
-	      safeStrCpy( buf, "?" , 2*MSG_SIZ);
-            break;
-        case GLT_BLACK_ELO:
-            if( gameInfo->blackRating > 0 )
-                sprintf( buf, "%d", gameInfo->blackRating );
-            else
-	      safeStrCpy( buf, "?" , 2*MSG_SIZ);
-            break;
-        case GLT_TIME_CONTROL:
-            strncpy( buf, gameInfo->timeControl ? gameInfo->timeControl : "?", MAX_FIELD_LEN );
-            break;
-        case GLT_VARIANT:
-            strncpy( buf, gameInfo->variantName ? gameInfo->variantName : VariantName(gameInfo->variant), MAX_FIELD_LEN );
-//            strncpy( buf, VariantName(gameInfo->variant), MAX_FIELD_LEN );
-            break;
-        case GLT_OUT_OF_BOOK:
-            strncpy( buf, gameInfo->outOfBook ? gameInfo->outOfBook : "?", MAX_FIELD_LEN );
-            break;
-        case GLT_RESULT_COMMENT:
-            strncpy( buf, gameInfo->resultDetails ? gameInfo->resultDetails : "res?", MAX_FIELD_LEN );
-            break;
-        default:
-            break;
-        }
-
-        buf[MAX_FIELD_LEN-1] = '\0';
-
-        buf += strlen( buf );
+        buf = GameListField( *glt, gameInfo, buf );
 
         glt++;
 
@@ -546,6 +555,110 @@ GameListLine (int number, GameInfo * gameInfo)
     return strdup( buffer );
 }
 
+/* [HGM] columns: the tags shown in the game list are stored per tag type as an index into a
+   table of distinct strings, so that a text filter has to be tried on every different event,
+   player or date only once, rather than on a list line formatted for every game.          */
+static char **tagStrings;      // distinct strings, as they appear in the list lines
+static int *tagValues;         // their numeric value (for dates)
+static char *tagMatch;         // per string: 0 = not tried yet, 1 = no match, 2 = match
+static int nTagStrings, maxTagStrings;
+static int *tagHash, hashSize; // open addressing, holds string number + 1
+static int *tagColumn[128];    // per GLT_XXX tag, per game: number of its string
+static char matchPattern[MSG_SIZ];
+
+static unsigned int
+TagHash (char *s)
+{
+    unsigned int h = 0;
+    while(*s) h = 33*h ^ (unsigned char) *s++;
+    return h;
+}
+
+static int
+InternTag (char *s)
+{
+    unsigned int h;
+    int i, n;
+
+    if(2*nTagStrings >= hashSize) { // grow hash table, and enter the strings we have again
+	free(tagHash);
+	hashSize = hashSize ? 2*hashSize : 1024;
+	tagHash = (int *) calloc(hashSize, sizeof(int));
+	for(i=0; i<nTagStrings; i++) {
+	    for(h = TagHash(tagStrings[i]); tagHash[h & hashSize-1]; h++);
+	    tagHash[h & hashSize-1] = i + 1;
+	}
+    }
+    for(h = TagHash(s); (n = tagHash[h & hashSize-1]); h++) // linear probing
+	if(!strcmp(tagStrings[n-1], s)) return n-1;
+    if(nTagStrings >= maxTagStrings) {
+	maxTagStrings = maxTagStrings ? 2*maxTagStrings : 1024;
+	tagStrings = (char **) realloc(tagStrings, maxTagStrings * sizeof(char *));
+	tagValues = (int *) realloc(tagValues, maxTagStrings * sizeof(int));
+	tagMatch = (char *) realloc(tagMatch, maxTagStrings);
+    }
+    tagHash[h & hashSize-1] = nTagStrings + 1;
+    tagStrings[nTagStrings] = StrSave(s);
+    tagValues[nTagStrings] = atoi(s);
+    tagMatch[nTagStrings] = 0;
+    return nTagStrings++;
+}
+
+static int *
+TagColumn (int tag)
+{   // make the column for a tag type when it is first needed
+    ListGame *lg;
+    char buf[2*MSG_SIZ];
+    int *col = tagColumn[tag & 127];
+
+    if(col) return col;
+    col = (int *) malloc(((ListGame *) gameList.tailPred)->number * sizeof(int));
+    for(lg = (ListGame *) gameList.head; lg->node.succ; lg = (ListGame *) lg->node.succ) {
+	GameListField(tag, &lg->gameInfo, buf);
+	col[lg->number - 1] = InternTag(buf);
+    }
+    return tagColumn[tag & 127] = col;
+}
+
+static void
+FreeTagColumns ()
+{
+    int i;
+    for(i=0; i<128; i++) free(tagColumn[i]), tagColumn[i] = NULL;
+    for(i=0; i<nTagStrings; i++) free(tagStrings[i]);
+    free(tagHash); tagHash = NULL;
+    nTagStrings = hashSize = 0;
+}
+
+/* Test whether the list line of a game would contain the pattern, from the columns.
+   This is only possible when the pattern cannot extend over two fields, -1 is returned otherwise */
+int
+GameListLineMatches (ListGame *lg, char *pattern)
+{
+    char *glt, buf[MSG_SIZ];
+
+    if(strpbrk(pattern, "*?., ")) return -1; // wildcard, or could match separators between fields
+    if(strcmp(pattern, matchPattern)) { // new pattern: forget which strings matched
+	safeStrCpy(matchPattern, pattern, MSG_SIZ);
+	for(glt = tagMatch; glt < tagMatch + nTagStrings; glt++) *glt = 0;
+    }
+    snprintf(buf, MSG_SIZ, "%d", lg->number);
+    if(SearchPattern(buf, pattern)) return TRUE;
+    for(glt = appData.gameListTags; *glt; glt++) {
+	int n = TagColumn(*glt)[lg->number - 1];
+	if(!tagMatch[n]) tagMatch[n] = 1 + SearchPattern(tagStrings[n], pattern);
+	if(tagMatch[n] == 2) return TRUE;
+    }
+    return FALSE;
+}
+
+/* Numeric value of a tag of a game, as it appears in the list (so 0 when absent) */
+int
+GameListTagValue (ListGame *lg, int tag)
+{
+    return tagValues[TagColumn(tag)[lg->number - 1]];
+}
+
 char *
 GameListLineFull (int number, GameInfo * gameInfo)
 {
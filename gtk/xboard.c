@@ -854,7 +854,7 @@ GtkosxApplication *theApp;
 int
 main (int argc, char **argv)
 {
-    int i, clockFontPxlSize, coordFontPxlSize, fontPxlSize;
+    int i, clockFontPxlSize, coordFontPxlSize, fontPxlSize, haveDisplay;
     int boardWidth, w, h; //, boardHeight;
     char *p;
     int forceMono = False;
@@ -876,7 +876,7 @@ main (int argc, char **argv)
     }
 
     /* set up GTK */
-    gtk_init (&argc, &argv);
+    haveDisplay = gtk_init_check (&argc, &argv); // [HGM] diagram: headless export does not need one
 #ifdef OSXAPP
     {   // prepare to catch OX OpenFile signal, which will tell us the clicked file
 	char *path = gtkosx_application_get_bundle_path();
@@ -926,7 +926,7 @@ main (int argc, char **argv)
     }
 
     /* set up keyboard accelerators group */
-    GtkAccelerators = gtk_accel_group_new();
+    if(haveDisplay) GtkAccelerators = gtk_accel_group_new();
 
     programName = strrchr(argv[0], '/');
     if (programName == NULL)
@@ -1007,6 +1007,13 @@ main (int argc, char **argv)
 	gameInfo.variant = StringToVariant(appData.variant);
 	InitPosition(FALSE);
 
+    if(*appData.diagramFile) { // [HGM] diagram: headless export, so no screen to size for
+	if(!*appData.boardSize) appData.boardSize = "Medium";
+    } else if(!haveDisplay) {
+	fprintf(stderr, _("%s: cannot open display\n"), programName);
+	exit(1);
+    }
+
     /*
      * determine size, based on supplied or remembered -size, or screen size
      */
@@ -1076,6 +1083,8 @@ main (int argc, char **argv)
     defaultLineGap = lineGap;
     if(appData.overrideLineGap >= 0) lineGap = appData.overrideLineGap;
 
+    if(*appData.diagramFile) exit(SaveDiagrams()); // [HGM] diagram: headless batch export, no windows
+
     /* [HR] height treated separately (hacked) */
     boardWidth = lineGap + BOARD_WIDTH * (squareSize + lineGap);
 //    boardHeight = lineGap + BOARD_HEIGHT * (squareSize + lineGap);
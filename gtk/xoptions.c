@@ -826,19 +826,26 @@ gboolean GenericPopDown(w, resptype, gdata)
 
 int AppendText(Option *opt, char *s)
 {
-    char *v;
     int len;
     GtkTextIter end;
 
-    GetWidgetTextGTK(opt->handle, &v);
-    len = strlen(v);
-    g_free(v);
+    len = gtk_text_buffer_get_char_count(GTK_TEXT_BUFFER(opt->handle)); // offset in chars, as used by HighlightText
     gtk_text_buffer_get_end_iter(GTK_TEXT_BUFFER(opt->handle), &end);
     gtk_text_buffer_insert(opt->handle, &end, s, -1);
 
     return len;
 }
 
+void
+TruncateText (Option *opt, int pos)
+{   // delete everything from given offset
+    GtkTextIter start, end;
+
+    gtk_text_buffer_get_iter_at_offset(GTK_TEXT_BUFFER(opt->handle), &start, pos);
+    gtk_text_buffer_get_end_iter(GTK_TEXT_BUFFER(opt->handle), &end);
+    gtk_text_buffer_delete(GTK_TEXT_BUFFER(opt->handle), &start, &end);
+}
+
 void
 SetColor (char *colorName, Option *box)
 {       // sets the color of a widget
@@ -181,6 +181,75 @@ StartLoadGameTimer (long millisec)
 	g_timeout_add( millisec, (GSourceFunc) LoadGameTimerCallback, NULL);
 }
 
+guint outputTimerTag = 0;
+
+int
+OutputTimerRunning ()
+{
+    return outputTimerTag != 0;
+}
+
+void
+OutputTimerCallback(gpointer data)
+{
+    g_source_remove(outputTimerTag);
+    outputTimerTag = 0;
+    DrainPacedOutput();
+}
+
+void
+StartOutputTimer (long millisec)
+{
+    outputTimerTag =
+	g_timeout_add( millisec, (GSourceFunc) OutputTimerCallback, NULL);
+}
+
+guint animationTimerTag = 0;
+
+int
+AnimationTimerRunning ()
+{
+    return animationTimerTag != 0;
+}
+
+void
+AnimationTimerCallback(gpointer data)
+{
+    g_source_remove(animationTimerTag);
+    animationTimerTag = 0;
+    AnimationTimerEvent();
+}
+
+void
+StartAnimationTimer (long millisec)
+{
+    animationTimerTag =
+	g_timeout_add( millisec, (GSourceFunc) AnimationTimerCallback, NULL);
+}
+
+guint engineOutputTimerTag = 0;
+
+int
+EngineOutputTimerRunning ()
+{
+    return engineOutputTimerTag != 0;
+}
+
+void
+EngineOutputTimerCallback(gpointer data)
+{
+    g_source_remove(engineOutputTimerTag);
+    engineOutputTimerTag = 0;
+    FlushEngineOutput();
+}
+
+void
+StartEngineOutputTimer (long millisec)
+{
+    engineOutputTimerTag =
+	g_timeout_add( millisec, (GSourceFunc) EngineOutputTimerCallback, NULL);
+}
+
 guint analysisClockTag = 0;
 
 void
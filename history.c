@@ -38,6 +38,7 @@
 
 /* templates for low-level front-end tasks (requiring platform-dependent implementation) */
 void ClearHistoryMemo P((void));                                   // essential
+void TruncateHistoryMemo P((int offset));                          // essential
 int AppendToHistoryMemo P(( char * text, int bold, int colorNr )); // essential (coloring / styling optional)
 void HighlightMove P(( int from, int to, Boolean highlight ));     // optional (can be dummy)
 void ScrollToCurrent P((int caretPos));                            // optional (can be dummy)
@@ -63,11 +64,14 @@ static int currLast = 0;
 static int currCurrent = -1;
 
 typedef struct {
+    int memoStart;  // [HGM] diff: where everything for this move (including number) begins
     int memoOffset;
     int memoLength;
+    char shown[ MOVE_LEN*2 + 24 ]; // move text and eval as they were put in the memo
 } HistoryMove;
 
 static HistoryMove histMoves[ MAX_MOVES ];
+static int shownFirst = 0, shownLast = 0; // moves present in the memo
 
 /* Note: in the following code a "Memo" is a Rich Edit control (it's Delphi lingo) */
 
@@ -118,6 +122,16 @@ OneMoveAppended ()
     return result;
 }
 
+// [HGM] diff: what AppendMoveToMemo puts in the memo for a move, to see whether it is still there
+static void
+ShownText (int index, char *buf)
+{
+    int len = sizeof(histMoves[0].shown);
+    snprintf( buf, len, "%s", SavePart( currMovelist[index] ) );
+    if( appData.showEvalInMoveHistory && currPvInfo[index].depth > 0 )
+        snprintf( buf + strlen(buf), len - strlen(buf), " {%.2f/%d}", currPvInfo[index].score / 100.0, currPvInfo[index].depth );
+}
+
 // back-end, now that color and font-style are passed as numbers
 static void
 AppendMoveToMemo (int index)
@@ -129,11 +143,12 @@ AppendMoveToMemo (int index)
     }
 
     buf[0] = '\0';
+    ShownText( index, histMoves[index].shown );
 
     /* Move number */
     if( (index % 2) == 0 ) {
         sprintf( buf, "%d.%s ", (index / 2)+1, index & 1 ? ".." : "" );
-        AppendToHistoryMemo( buf, 1, 0 ); // [HGM] 1 means bold, 0 default color
+        histMoves[index].memoStart = AppendToHistoryMemo( buf, 1, 0 ); // [HGM] 1 means bold, 0 default color
     }
 
     /* Move text */
@@ -142,6 +157,7 @@ AppendMoveToMemo (int index)
 
     histMoves[index].memoOffset = AppendToHistoryMemo( buf, 0, 0 );
     histMoves[index].memoLength = strlen(buf)-1;
+    if( index % 2 ) histMoves[index].memoStart = histMoves[index].memoOffset;
 
     /* PV info (if any) */
     if( appData.showEvalInMoveHistory && currPvInfo[index].depth > 0 ) {
@@ -160,11 +176,44 @@ RefreshMemoContent ()
 {
     int i;
 
+    VerifyHistory( currFirst, currLast ); // [HGM] fast history: all shown moves need their SAN
     ClearHistoryMemo();
 
     for( i=currFirst; i<currLast; i++ ) {
         AppendMoveToMemo( i );
     }
+
+    shownFirst = currFirst;
+    shownLast = currLast;
+}
+
+// [HGM] diff: after take-back, loading a game that starts the same, or switching variations,
+// only the moves from the first one that is shown differently have to be replaced
+static void
+UpdateMemoContent ()
+{
+    char buf[ sizeof(histMoves[0].shown) ];
+    int i = currFirst;
+
+    if( currFirst == shownFirst ) {
+        for( ; i<currLast && i<shownLast; i++ ) {
+            ShownText( i, buf );
+            if( strcmp( buf, histMoves[i].shown ) ) break;
+        }
+    }
+
+    if( i == currFirst ) { // nothing in common
+        RefreshMemoContent();
+        return;
+    }
+
+    if( i < shownLast ) TruncateHistoryMemo( histMoves[i].memoStart );
+
+    for( ; i<currLast; i++ ) {
+        AppendMoveToMemo( i );
+    }
+
+    shownLast = currLast;
 }
 
 // back-end part taken out of HighlightMove to determine character positions
@@ -211,14 +260,18 @@ MemoContentUpdated ()
 void
 FindMoveByCharIndex (int char_index)
 {
-    int index;
+    int lo = currFirst, hi = currLast, index; // [HGM] diff: offsets increase with index, so bisect
 
-    for( index=currFirst; index<currLast; index++ ) {
-        if( char_index >= histMoves[index].memoOffset &&
-            char_index <  (histMoves[index].memoOffset + histMoves[index].memoLength) )
-        {
-            ToNrEvent( index + 1 ); // moved here from call-back
-        }
+    while( hi - lo > 1 ) {
+        index = (lo + hi) / 2;
+        if( histMoves[index].memoOffset > char_index ) hi = index; else lo = index;
+    }
+
+    if( lo < currLast &&
+        char_index >= histMoves[lo].memoOffset &&
+        char_index <  (histMoves[lo].memoOffset + histMoves[lo].memoLength) )
+    {
+        ToNrEvent( lo + 1 ); // moved here from call-back
     }
 }
 
@@ -226,15 +279,18 @@ FindMoveByCharIndex (int char_index)
 void
 UpdateMoveHistory ()
 {
+        VerifyHistory( currFirst, currLast ); // [HGM] fast history: all shown moves need their SAN
+
         /* Update the GUI */
         if( OnlyCurrentPositionChanged() ) {
             /* Only "cursor" changed, no need to update memo content */
         }
         else if( OneMoveAppended() ) {
             AppendMoveToMemo( currCurrent );
+            shownLast = currLast;
         }
         else {
-            RefreshMemoContent();
+            UpdateMemoContent();
         }
 
         MemoContentUpdated();
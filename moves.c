@@ -72,7 +72,7 @@ int SameColor P((ChessSquare, ChessSquare));
 int PosFlags(int index);
 
 extern signed char initialRights[BOARD_FILES]; /* [HGM] all rights enabled, set in InitPosition */
-int quickFlag;
+MoveGenContext mainGen; // [HGM] gen: generator state of the GUI, set up by InitBackEnd1()
 char *pieceDesc[EmptySquare];
 char *defaultDesc[EmptySquare] = {
  "fmWfceFifmnD", "N", "B", "R", "Q",
@@ -219,7 +219,7 @@ CollectPieceDescriptors ()
 
 // [HGM] gen: configurable move generation from Betza notation sent by engine.
 // Some notes about two-leg moves: GenPseudoLegal() works in two modes, depending on whether a 'kill-
-// square has been set: without one is generates all moves, and a global int legNr flags in bits 0 and 1
+// square has been set: without one is generates all moves, and the context field 'legs' flags in bits 0 and 1
 // if the move has 1 or 2 legs. Only the marking of squares makes use of this info, by only marking
 // target squares of leg 1 (rejecting null move). A dummy move with MoveType 'FirstLeg' to the relay square
 // is generated, so a cyan marker can be put there, and other functions can ignore such a move. When the
@@ -261,28 +261,58 @@ OK (Board board, int flags, ChessMove kind, int rf, int ff, int rt, int ft, VOID
     (*(int*)cl)++;
 }
 
-void
-MovesFromString (Board board, int flags, int f, int r, int tx, int ty, int angle, char *desc, MoveCallback cb, VOIDSTAR cl)
+#define MODE_HIS  0x1000 // 'c' and 'd' modes, resolved to the occupation bits of the moving side when generating
+#define MODE_MINE 0x2000
+
+typedef struct BetzaAtom { // [HGM] gen: one atom of a Betza descriptor, as decoded by CompileAtoms()
+    struct BetzaAtom *next;    // next atom of the move (only on first legs)
+    struct BetzaAtom *cont[2]; // continuation leg, and the same with orth-diag interconverted atom
+    char leg;                  // non-final leg ('a' modifier)
+    char kingSystem;           // directions in K/Q system: re-oriented along previous leg, orth and diag separately
+    char initial;              // only from initial position
+    char dx, dy;               // step vector
+    unsigned char dirSet;      // directions (before re-orientation and inversion for black)
+    unsigned char all;         // directions in which the continuation leg keeps its atom
+    int expo, jump, skip, mode;
+} BetzaAtom;
+
+/* [HGM] gen: only CompilePieceDesc() writes these, when a variant is set up or an engine defines a piece.
+   The generators merely read them, so contexts used from other threads can share them. */
+static BetzaAtom *pieceAtoms[EmptySquare]; // compiled pieceDesc[]
+static int pieceAttacks[EmptySquare];       // [HGM] attack: how those capture, for SquareAttacked()
+static int AtomAttacks P((BetzaAtom *a, int black));
+
+static void
+FreeAtoms (BetzaAtom *a)
 {
+    while(a) {
+	BetzaAtom *next = a->next;
+	FreeAtoms(a->cont[0]); FreeAtoms(a->cont[1]);
+	free(a);
+	a = next;
+    }
+}
+
+static BetzaAtom *
+CompileAtoms (char *desc, int leg)
+{   // decode the string once, so that move generation does not have to parse it again;
+    // for a continuation leg (leg = TRUE) only the first atom is used
     char buf[80], *p = desc, *atom = NULL;
-    int mine, his, dir, bit, occup, i, promoRank = -1;
-    ChessMove promo= NormalMove; ChessSquare pc = board[r][f];
-    if(flags & F_WHITE_ON_MOVE) his = 2, mine = 1; else his = 1, mine = 2;
-    if(pc == WhitePawn || pc == WhiteLance) promo = WhitePromotion, promoRank = BOARD_HEIGHT-1; else
-    if(pc == BlackPawn || pc == BlackLance) promo = BlackPromotion, promoRank = 0;
+    int i;
+    BetzaAtom *list = NULL, **tail = &list, *a;
     while(*p) {                  // more moves to go
-	int expo = 1, dx, dy, x, y, mode, dirSet, ds2=0, retry=0, initial=0, jump=1, skip = 0, all = 0;
+	int expo = 1, dx, dy, mode, dirSet, jump=1, skip = 0, all = 0, king = 0, initial = 0;
 	char *cont = NULL;
 	if(*p == 'i') initial = 1, desc = ++p;
 	while(islower(*p)) p++;  // skip prefixes
-	if(!isupper(*p)) return; // syntax error: no atom
+	if(!isupper(*p)) break;  // syntax error: no atom
 	dx = xStep[*p-'A'] - '0';// step vector of atom
 	dy = yStep[*p-'A'] - '0';
 	dirSet = 0;              // build direction set based on atom symmetry
 	switch(symmetry[*p-'A']) {
 	  case 'B': expo = 0;    // bishop, slide
 	  case 'F': all = 0xAA;  // diagonal atom (degenerate 4-fold)
-		    if(tx >= 0) goto king;        // continuation legs specified in K/Q system!
+		    if(leg) goto king;            // continuation legs specified in K/Q system!
 		    while(islower(*desc) && (i = dirType[*desc-'a']) != '0') {
 			int b = dirs1[*desc-'a']; // use wide version
 			if( islower(desc[1]) &&
@@ -296,13 +326,12 @@ MovesFromString (Board board, int flags, int f, int r, int tx, int ty, int angle
 		    break;
 	  case 'R': expo = 0;    // rook, slide
 	  case 'W': all = 0x55;  // orthogonal atom (non-deg 4-fold)
-		    if(tx >= 0) goto king;        // continuation legs specified in K/Q system!
+		    if(leg) goto king;            // continuation legs specified in K/Q system!
 		    while(islower(*desc) && (dirType[*desc-'a'] & ~4) != '0') dirSet |= dirs2[*desc++-'a'];
 		    dirSet &= 0x55; if(!dirSet) dirSet = 0x55;
-		    dirSet = (dirSet << angle | dirSet >> 8-angle) & 255;   // re-orient direction system
 		    break;
 	  case 'N': all = 0xFF;  // oblique atom (degenerate 8-fold)
-		    if(tx >= 0) goto king;        // continuation legs specified in K/Q system!
+		    if(leg) goto king;            // continuation legs specified in K/Q system!
 		    if(*desc == 'h') {            // chiral direction sets 'hr' and 'hl'
 			dirSet = (desc[1] == 'r' ? 0x55 :  0xAA); desc += 2;
  		    } else
@@ -321,6 +350,7 @@ MovesFromString (Board board, int flags, int f, int r, int tx, int ty, int angle
 	  case 'Q': expo = 0;    // queen, slide
 	  case 'K': all = 0xFF;  // non-deg (pseudo) 8-fold
 	  king:
+		    king = 1;
 		    while(islower(*desc) && (i = dirType[*desc-'a']) != '0') {
 			int b = dirs4[*desc-'a'];    // when alone, use narrow version
 			if(desc[1] == *desc) desc++; // doubling forces alone
@@ -331,21 +361,15 @@ MovesFromString (Board board, int flags, int f, int r, int tx, int ty, int angle
 			} else desc++;
 			dirSet |= b;
 		    }
-		    if(!dirSet) dirSet = (tx < 0 ? 0xFF                     // default is all directions, but in continuation leg
+		    if(!dirSet) dirSet = (!leg ? 0xFF                       // default is all directions, but in continuation leg
 					  : all == 0xFF ? 0xEF : 0x45);     // omits backward, and for 4-fold atoms also diags
-		    dirSet = (dirSet << angle | dirSet >> 8-angle) & 255;   // re-orient direction system
-		    ds2 = dirSet & 0xAA;          // extract diagonal directions
-		    if(dirSet &= 0x55)            // start with orthogonal moves, if present
-		         retry = 1, dx = 0;       // and schedule the diagonal moves for later
-		    else dx = dy, dirSet = ds2;   // if no orthogonal directions, do diagonal immediately
 		    break;       // should not have direction indicators
-	  default:  return;      // syntax error: invalid atom
+	  default:  return list; // syntax error: invalid atom
 	}
-	if(mine == 2 && tx < 0) dirSet = dirSet >> 4 | dirSet << 4 & 255;   // invert black moves
 	mode = 0;                // build mode mask
 	if(*desc == 'm') mode |= 4, desc++;           // move to empty
-	if(*desc == 'c') mode |= his, desc++;         // capture foe
-	if(*desc == 'd') mode |= mine, desc++;        // destroy (capture friend)
+	if(*desc == 'c') mode |= MODE_HIS, desc++;    // capture foe
+	if(*desc == 'd') mode |= MODE_MINE, desc++;   // destroy (capture friend)
 	if(*desc == 'e') mode |= 8, desc++;           // e.p. capture last mover
 	if(*desc == 't') mode |= 16, desc++;          // exclude enemies as hop platform ('test')
 	if(*desc == 'p') mode |= 32, desc++;          // hop over occupied
@@ -358,14 +382,12 @@ MovesFromString (Board board, int flags, int f, int r, int tx, int ty, int angle
 	if(isdigit(*++p)) expo = atoi(p++);           // read exponent
 	if(expo > 9) p++;                             // allow double-digit
 	desc = p;                                     // this is start of next move
-	if(initial && (board[r][f] != initialPosition[r][f] ||
-		       r == 0              && board[TOUCHED_W] & 1<<f ||
-		       r == BOARD_HEIGHT-1 && board[TOUCHED_B] & 1<<f   ) ) continue;
 	if(expo > 1 && dx == 0 && dy == 0) {          // castling indicated by O + number
 	    mode |= 1024; dy = 1;
 	}
+	if(!(a = (BetzaAtom *) calloc(1, sizeof(BetzaAtom)))) break;
         if(!cont) {
-	    if(!(mode & 15)) mode |= his + 4;         // no mode spec, use default = mc
+	    if(!(mode & 15 + MODE_HIS + MODE_MINE)) mode |= MODE_HIS + 4; // no mode spec, use default = mc
 	} else {
 	    strncpy(buf, cont, 80); cont = buf;       // copy next leg(s), so we can modify
 	    atom = buf; while(islower(*atom)) atom++; // skip to atom
@@ -377,14 +399,58 @@ MovesFromString (Board board, int flags, int f, int r, int tx, int ty, int angle
 		atom[1] = atom[2] = '\0';             // make sure any old range is stripped off
 		if(expo == 1) atom[1] = '0';          // turn other leapers into riders 
 	    }
-	    if(!(mode & 0x30F)) mode |= 4;            // and default of this leg = m
+	    if(!(mode & 0x30F + MODE_HIS + MODE_MINE)) mode |= 4; // and default of this leg = m
+	    a->leg = 1;
+	    a->cont[0] = CompileAtoms(buf, TRUE);
+	    if(isupper(*atom)) *atom = rotate[*atom - 'A']; // orth-diag interconversion to make direction valid
+	    a->cont[1] = CompileAtoms(buf, TRUE);
 	}
 	if(dy == 1) skip = jump - 1, jump = 1;        // on W & F atoms 'j' = skip first square
+	a->kingSystem = king; a->initial = initial;
+	a->dx = dx; a->dy = dy; a->dirSet = dirSet; a->all = all;
+	a->expo = expo; a->jump = jump; a->skip = skip; a->mode = mode;
+	*tail = a; tail = &a->next;
+	if(leg) break;           // don't do other atoms in continuation legs
+    }
+    return list;
+}
+
+void
+CompilePieceDesc (ChessSquare piece)
+{   // to be called whenever pieceDesc[piece] changes
+    FreeAtoms(pieceAtoms[piece]);
+    pieceAtoms[piece] = pieceDesc[piece] ? CompileAtoms(pieceDesc[piece], FALSE) : NULL;
+    pieceAttacks[piece] = AtomAttacks(pieceAtoms[piece], piece >= BlackPawn);
+    InvalidateMoveCache();
+}
+
+static void
+MovesFromAtoms (MoveGenContext *gc, Board board, int flags, int f, int r, int tx, int ty, int angle, BetzaAtom *a, MoveCallback cb, VOIDSTAR cl)
+{
+    int mine, his, dir, bit, occup, promoRank = -1;
+    ChessMove promo= NormalMove; ChessSquare pc = board[r][f];
+    if(flags & F_WHITE_ON_MOVE) his = 2, mine = 1; else his = 1, mine = 2;
+    if(pc == WhitePawn || pc == WhiteLance) promo = WhitePromotion, promoRank = BOARD_HEIGHT-1; else
+    if(pc == BlackPawn || pc == BlackLance) promo = BlackPromotion, promoRank = 0;
+    for(; a; a = a->next) {      // more moves to go
+	int expo = a->expo, dx = a->dx, dy = a->dy, x, y, mode, dirSet = a->dirSet, ds2=0, retry=0;
+	int leg = a->leg, skip = a->skip, jump = a->jump;
+	if(a->initial && (board[r][f] != initialPosition[r][f] ||
+		       r == 0              && board[TOUCHED_W] & 1<<f ||
+		       r == BOARD_HEIGHT-1 && board[TOUCHED_B] & 1<<f   ) ) continue;
+	if(a->kingSystem) {
+	    dirSet = (dirSet << angle | dirSet >> 8-angle) & 255;   // re-orient direction system
+	    ds2 = dirSet & 0xAA;          // extract diagonal directions
+	    if(dirSet &= 0x55)            // start with orthogonal moves, if present
+		 retry = 1, dx = 0;       // and schedule the diagonal moves for later
+	    else dx = dy, dirSet = ds2;   // if no orthogonal directions, do diagonal immediately
+	}
+	if(mine == 2 && tx < 0) dirSet = dirSet >> 4 | dirSet << 4 & 255;   // invert black moves
+	mode = a->mode & ~(MODE_HIS | MODE_MINE) | (a->mode & MODE_HIS ? his : 0) | (a->mode & MODE_MINE ? mine : 0);
         do {
 	  for(dir=0, bit=1; dir<8; dir++, bit += bit) { // loop over directions
 	    int i = expo, j = skip, hop = mode, vx, vy, loop = 0;
 	    if(!(bit & dirSet)) continue;             // does not move in this direction
-	    if(dy != 1) j = 0;                        // 
 	    vx = dx*rot[dir][0] + dy*rot[dir][1];     // rotate step vector
 	    vy = dx*rot[dir][2] + dy*rot[dir][3];
 	    if(tx < 0) x = f, y = r;                  // start square
@@ -401,24 +467,22 @@ MovesFromString (Board board, int flags, int f, int r, int tx, int ty, int angle
 		if(board[y][x] < BlackPawn)   occup = 0x101; else
 		if(board[y][x] < EmptySquare) occup = 0x102; else
 					      occup = 4;
-		if(cont) {                            // non-final leg
+		if(leg) {                             // non-final leg
 		  if(mode&16 && his&occup) occup &= 3;// suppress hopping foe in t-mode
 		  if(occup & mode) {                  // valid intermediate square, do continuation
-		    char origAtom = *atom;
-		    if(!(bit & all)) *atom = rotate[*atom - 'A']; // orth-diag interconversion to make direction valid
+		    BetzaAtom *cont = a->cont[!(bit & a->all)]; // orth-diag interconversion to make direction valid
 		    if(occup & mode & 0x104)          // no side effects, merge legs to one move
-			MovesFromString(board, flags, f, r, x, y, dir, cont, cb, cl);
-		    if(occup & mode & 3 && (killX < 0 || killX == x && killY == y)) {     // destructive first leg
+			MovesFromAtoms(gc, board, flags, f, r, x, y, dir, cont, cb, cl);
+		    if(occup & mode & 3 && (gc->killFile < 0 || gc->killFile == x && gc->killRank == y)) { // destructive first leg
 			int cnt = 0;
-			MovesFromString(board, flags, f, r, x, y, dir, cont, &OK, &cnt);  // count possible continuations
+			MovesFromAtoms(gc, board, flags, f, r, x, y, dir, cont, &OK, &cnt);  // count possible continuations
 			if(cnt) {                                                         // and if there are
-			    if(killX < 0) cb(board, flags, FirstLeg, r, f, y, x, cl);     // then generate their first leg
-			    legNr <<= 1;
-			    MovesFromString(board, flags, f, r, x, y, dir, cont, cb, cl);
-			    legNr >>= 1;
+			    if(gc->killFile < 0) cb(board, flags, FirstLeg, r, f, y, x, cl); // then generate their first leg
+			    gc->legs <<= 1;
+			    MovesFromAtoms(gc, board, flags, f, r, x, y, dir, cont, cb, cl);
+			    gc->legs >>= 1;
 			}
 		    }
-		    *atom = origAtom;        // undo any interconversion
 		  }
 		  if(occup != 4) break;      // occupied squares always terminate the leg
 		  continue;
@@ -449,30 +513,73 @@ MovesFromString (Board board, int flags, int f, int r, int tx, int ty, int angle
 
 // [HGM] move generation now based on hierarchy of subroutines for rays and combinations of rays
 
+/* [HGM] speed: number of squares from every square to the board edge in each direction, and the number of
+   Knight jumps that fit in each jump direction, so that sliders and leapers need no bounds test per step */
+static int rayStep[8][2]  = { {1,0}, {-1,0}, {0,1}, {0,-1}, {1,1}, {1,-1}, {-1,1}, {-1,-1} };
+static int jumpStep[8][2] = { {-1,-2}, {-2,-1}, {-1,2}, {-2,1}, {1,-2}, {2,-1}, {1,2}, {2,1} };
+static unsigned char rayLength[BOARD_RANKS][BOARD_FILES][8], jumpLength[BOARD_RANKS][BOARD_FILES][8];
+
+#define RAY_N   0 // directions in rayStep[] order; forward is towards higher ranks
+#define RAY_S   1
+#define RAY_E   2
+#define RAY_W   3
+#define RAY_NE  4
+#define RAY_NW  5
+#define RAY_SE  6
+#define RAY_SW  7
+
+#define JUMP(dr, df) (4*((dr) > 0) + 2*((df) > 0) + ((dr) == 2 || (dr) == -2)) // index of a Knight jump in jumpStep[]
+
+static int
+Fit (int up, int down, int right, int left, int dr, int df)
+{   // number of (dr,df) steps that fit within the given distances to the edges
+    int v = (dr > 0 ? up/dr : dr < 0 ? down/-dr : 1000), h = (df > 0 ? right/df : df < 0 ? left/-df : 1000);
+    return v < h ? v : h;
+}
+
 void
-SlideForward (Board board, int flags, int rf, int ff, MoveCallback callback, VOIDSTAR closure)
+MakeRays ()
+{   // to be called whenever the board size changes; the generators only read the tables
+    int r, f, d;
+    for(r=0; r<BOARD_HEIGHT; r++) for(f=BOARD_LEFT; f<BOARD_RGHT; f++) {
+	int up = BOARD_HEIGHT-1-r, down = r, right = BOARD_RGHT-1-f, left = f-BOARD_LEFT;
+	for(d=0; d<8; d++) {
+	    rayLength[r][f][d]  = Fit(up, down, right, left, rayStep[d][0],  rayStep[d][1]);
+	    jumpLength[r][f][d] = Fit(up, down, right, left, jumpStep[d][0], jumpStep[d][1]);
+	}
+    }
+}
+
+static void
+Slide (Board board, int flags, int rf, int ff, int d, MoveCallback callback, VOIDSTAR closure)
 {
-  int i, rt, ft = ff;
-  for (i = 1;; i++) {
-      rt = rf + i;
-      if (rt >= BOARD_HEIGHT) break;
+  int n = rayLength[rf][ff][d], rt = rf, ft = ff;
+  while (n--) {
+      rt += rayStep[d][0]; ft += rayStep[d][1];
       if (SameColor(board[rf][ff], board[rt][ft])) break;
       callback(board, flags, NormalMove, rf, ff, rt, ft, closure);
       if (board[rt][ft] != EmptySquare) break;
   }
 }
 
+static void
+Step (Board board, int flags, int rf, int ff, int d, MoveCallback callback, VOIDSTAR closure)
+{
+  int rt = rf + rayStep[d][0], ft = ff + rayStep[d][1];
+  if (rayLength[rf][ff][d] && !SameColor(board[rf][ff], board[rt][ft]))
+      callback(board, flags, NormalMove, rf, ff, rt, ft, closure);
+}
+
+void
+SlideForward (Board board, int flags, int rf, int ff, MoveCallback callback, VOIDSTAR closure)
+{
+  Slide(board, flags, rf, ff, RAY_N, callback, closure);
+}
+
 void
 SlideBackward (Board board, int flags, int rf, int ff, MoveCallback callback, VOIDSTAR closure)
 {
-  int i, rt, ft = ff;
-  for (i = 1;; i++) {
-      rt = rf - i;
-      if (rt < 0) break;
-      if (SameColor(board[rf][ff], board[rt][ft])) break;
-      callback(board, flags, NormalMove, rf, ff, rt, ft, closure);
-      if (board[rt][ft] != EmptySquare) break;
-  }
+  Slide(board, flags, rf, ff, RAY_S, callback, closure);
 }
 
 void
@@ -485,48 +592,22 @@ SlideVertical (Board board, int flags, int rf, int ff, MoveCallback callback, VO
 void
 SlideSideways (Board board, int flags, int rf, int ff, MoveCallback callback, VOIDSTAR closure)
 {
-  int i, s, rt = rf, ft;
-  for(s = -1; s <= 1; s+= 2) {
-    for (i = 1;; i++) {
-      ft = ff + i*s;
-      if (ft < BOARD_LEFT || ft >= BOARD_RGHT) break;
-      if (SameColor(board[rf][ff], board[rt][ft])) break;
-      callback(board, flags, NormalMove, rf, ff, rt, ft, closure);
-      if (board[rt][ft] != EmptySquare) break;
-    }
-  }
+  Slide(board, flags, rf, ff, RAY_W, callback, closure);
+  Slide(board, flags, rf, ff, RAY_E, callback, closure);
 }
 
 void
 SlideDiagForward (Board board, int flags, int rf, int ff, MoveCallback callback, VOIDSTAR closure)
 {
-  int i, s, rt, ft;
-  for(s = -1; s <= 1; s+= 2) {
-    for (i = 1;; i++) {
-      rt = rf + i;
-      ft = ff + i * s;
-      if (rt >= BOARD_HEIGHT || ft < BOARD_LEFT || ft >= BOARD_RGHT) break;
-      if (SameColor(board[rf][ff], board[rt][ft])) break;
-      callback(board, flags, NormalMove, rf, ff, rt, ft, closure);
-      if (board[rt][ft] != EmptySquare) break;
-    }
-  }
+  Slide(board, flags, rf, ff, RAY_NW, callback, closure);
+  Slide(board, flags, rf, ff, RAY_NE, callback, closure);
 }
 
 void
 SlideDiagBackward (Board board, int flags, int rf, int ff, MoveCallback callback, VOIDSTAR closure)
 {
-  int i, s, rt, ft;
-  for(s = -1; s <= 1; s+= 2) {
-    for (i = 1;; i++) {
-      rt = rf - i;
-      ft = ff + i * s;
-      if (rt < 0 || ft < BOARD_LEFT || ft >= BOARD_RGHT) break;
-      if (SameColor(board[rf][ff], board[rt][ft])) break;
-      callback(board, flags, NormalMove, rf, ff, rt, ft, closure);
-      if (board[rt][ft] != EmptySquare) break;
-    }
-  }
+  Slide(board, flags, rf, ff, RAY_SW, callback, closure);
+  Slide(board, flags, rf, ff, RAY_SE, callback, closure);
 }
 
 void
@@ -544,78 +625,55 @@ Bishop (Board board, int flags, int rf, int ff, MoveCallback callback, VOIDSTAR
 }
 
 void
-Sting (Board board, int flags, int rf, int ff, int dy, int dx, MoveCallback callback, VOIDSTAR closure)
+Sting (MoveGenContext *gc, Board board, int flags, int rf, int ff, int dy, int dx, MoveCallback callback, VOIDSTAR closure)
 { // Lion-like move of Horned Falcon and Souring Eagle
-  int ft = ff + dx, rt = rf + dy;
-  if (rt < 0 || rt >= BOARD_HEIGHT || ft < BOARD_LEFT || ft >= BOARD_RGHT) return;
-  legNr += 2;
+  int ft = ff + dx, rt = rf + dy, n = rayLength[rf][ff][dx ? RAY_NE + 2*(dy < 0) + (dx < 0) : dy < 0];
+  if (n < 1) return;
+  gc->legs += 2;
   if (!SameColor(board[rf][ff], board[rt][ft]))
     callback(board, flags, board[rt][ft] != EmptySquare ? FirstLeg : NormalMove, rf, ff, rt, ft, closure);
-  legNr -= 2;
+  gc->legs -= 2;
   ft += dx; rt += dy;
-  if (rt < 0 || rt >= BOARD_HEIGHT || ft < BOARD_LEFT || ft >= BOARD_RGHT) return;
-  legNr += 2;
+  if (n < 2) return;
+  gc->legs += 2;
   if (!SameColor(board[rf][ff], board[rt][ft]))
     callback(board, flags, NormalMove, rf, ff, rt, ft, closure);
   if (!SameColor(board[rf][ff], board[rf+dy][ff+dx]))
     callback(board, flags, NormalMove, rf, ff, rf, ff, closure);
-  legNr -= 2;
+  gc->legs -= 2;
 }
 
 void
 StepForward (Board board, int flags, int rf, int ff, MoveCallback callback, VOIDSTAR closure)
 {
-  int ft = ff, rt = rf + 1;
-  if (rt >= BOARD_HEIGHT) return;
-  if (SameColor(board[rf][ff], board[rt][ft])) return;
-  callback(board, flags, NormalMove, rf, ff, rt, ft, closure);
+  Step(board, flags, rf, ff, RAY_N, callback, closure);
 }
 
 void
 StepBackward (Board board, int flags, int rf, int ff, MoveCallback callback, VOIDSTAR closure)
 {
-  int ft = ff, rt = rf - 1;
-  if (rt < 0) return;
-  if (SameColor(board[rf][ff], board[rt][ft])) return;
-  callback(board, flags, NormalMove, rf, ff, rt, ft, closure);
+  Step(board, flags, rf, ff, RAY_S, callback, closure);
 }
 
 void
 StepSideways (Board board, int flags, int rf, int ff, MoveCallback callback, VOIDSTAR closure)
 {
-  int ft, rt = rf;
-  ft = ff + 1;
-  if (!(rt >= BOARD_HEIGHT || ft >= BOARD_RGHT) && !SameColor(board[rf][ff], board[rt][ft]))
-      callback(board, flags, NormalMove, rf, ff, rt, ft, closure);
-  ft = ff - 1;
-  if (!(rt >= BOARD_HEIGHT || ft < BOARD_LEFT) && !SameColor(board[rf][ff], board[rt][ft]))
-      callback(board, flags, NormalMove, rf, ff, rt, ft, closure);
+  Step(board, flags, rf, ff, RAY_E, callback, closure);
+  Step(board, flags, rf, ff, RAY_W, callback, closure);
 }
 
 void
 StepDiagForward (Board board, int flags, int rf, int ff, MoveCallback callback, VOIDSTAR closure)
 {
-  int ft, rt = rf + 1;
-  if (rt >= BOARD_HEIGHT) return;
-  ft = ff + 1;
-  if (!(rt >= BOARD_HEIGHT || ft >= BOARD_RGHT) && !SameColor(board[rf][ff], board[rt][ft]))
-      callback(board, flags, NormalMove, rf, ff, rt, ft, closure);
-  ft = ff - 1;
-  if (!(rt >= BOARD_HEIGHT || ft < BOARD_LEFT) && !SameColor(board[rf][ff], board[rt][ft]))
-      callback(board, flags, NormalMove, rf, ff, rt, ft, closure);
+  Step(board, flags, rf, ff, RAY_NE, callback, closure);
+  Step(board, flags, rf, ff, RAY_NW, callback, closure);
 }
 
 void
 StepDiagBackward (Board board, int flags, int rf, int ff, MoveCallback callback, VOIDSTAR closure)
 {
-  int ft, rt = rf - 1;
-  if(rt < 0) return;
-  ft = ff + 1;
-  if (!(rt < 0 || ft >= BOARD_RGHT) && !SameColor(board[rf][ff], board[rt][ft]))
-      callback(board, flags, NormalMove, rf, ff, rt, ft, closure);
-  ft = ff - 1;
-  if (!(rt < 0 || ft < BOARD_LEFT) && !SameColor(board[rf][ff], board[rt][ft]))
-      callback(board, flags, NormalMove, rf, ff, rt, ft, closure);
+  Step(board, flags, rf, ff, RAY_SE, callback, closure);
+  Step(board, flags, rf, ff, RAY_SW, callback, closure);
 }
 
 void
@@ -642,17 +700,15 @@ Wazir (Board board, int flags, int rf, int ff, MoveCallback callback, VOIDSTAR c
 void
 Knight (Board board, int flags, int rf, int ff, MoveCallback callback, VOIDSTAR closure)
 {
-    int i, j, s, rt, ft;
-    for (i = -1; i <= 1; i += 2)
-	for (j = -1; j <= 1; j += 2)
-	    for (s = 1; s <= 2; s++) {
-		rt = rf + i*s;
-		ft = ff + j*(3-s);
-		if (!(rt < 0 || rt >= BOARD_HEIGHT || ft < BOARD_LEFT || ft >= BOARD_RGHT)
-		    && ( gameInfo.variant != VariantXiangqi || board[rf+i*(s-1)][ff+j*(2-s)] == EmptySquare)
-		    && !SameColor(board[rf][ff], board[rt][ft]))
-		    callback(board, flags, NormalMove, rf, ff, rt, ft, closure);
-	    }
+    int d, rt, ft;
+    for (d = 0; d < 8; d++) {
+	rt = rf + jumpStep[d][0];
+	ft = ff + jumpStep[d][1];
+	if (jumpLength[rf][ff][d]
+	    && ( gameInfo.variant != VariantXiangqi || board[rf+jumpStep[d][0]/2][ff+jumpStep[d][1]/2] == EmptySquare) // leg
+	    && !SameColor(board[rf][ff], board[rt][ft]))
+	    callback(board, flags, NormalMove, rf, ff, rt, ft, closure);
+    }
 }
 
 /* Call callback once for each pseudo-legal move in the given
@@ -665,6 +721,12 @@ Knight (Board board, int flags, int rf, int ff, MoveCallback callback, VOIDSTAR
 */
 void
 GenPseudoLegal (Board board, int flags, MoveCallback callback, VOIDSTAR closure, ChessSquare filter)
+{
+    GenPseudoLegalCtx(&mainGen, board, flags, callback, closure, filter);
+}
+
+void
+GenPseudoLegalCtx (MoveGenContext *gc, Board board, int flags, MoveCallback callback, VOIDSTAR closure, ChessSquare filter)
 // speed: only do moves with this piece type
 {
     int rf, ff;
@@ -682,8 +744,8 @@ GenPseudoLegal (Board board, int flags, MoveCallback callback, VOIDSTAR closure,
           if(PieceToChar(piece) == '~')
                  piece = (ChessSquare) ( DEMOTED piece );
           if(filter != EmptySquare && piece != filter) continue;
-          if(pieceDefs && pieceDesc[piece]) { // [HGM] gen: use engine-defined moves
-              MovesFromString(board, flags, ff, rf, -1, -1, 0, pieceDesc[piece], callback, closure);
+          if(pieceDefs && !gc->builtIn && pieceDesc[piece]) { // [HGM] gen: use engine-defined moves
+              MovesFromAtoms(gc, board, flags, ff, rf, -1, -1, 0, pieceAtoms[piece], callback, closure);
               continue;
           }
           if(IS_SHOGI(gameInfo.variant))
@@ -698,7 +760,7 @@ GenPseudoLegal (Board board, int flags, MoveCallback callback, VOIDSTAR closure,
              case WhitePawn:
               if(gameInfo.variant == VariantXiangqi) {
                   /* [HGM] capture and move straight ahead in Xiangqi */
-                  if (rf < BOARD_HEIGHT-1 &&
+                  if (rayLength[rf][ff][RAY_N] &&
                            !SameColor(board[rf][ff], board[rf + 1][ff]) ) {
                            callback(board, flags, NormalMove,
                                     rf, ff, rf + 1, ff, closure);
@@ -706,7 +768,7 @@ GenPseudoLegal (Board board, int flags, MoveCallback callback, VOIDSTAR closure,
                   /* and move sideways when across the river */
                   for (s = -1; s <= 1; s += 2) {
                       if (rf >= BOARD_HEIGHT>>1 &&
-                          ff + s >= BOARD_LEFT && ff + s < BOARD_RGHT &&
+                          rayLength[rf][ff][s < 0 ? RAY_W : RAY_E] &&
                           !WhitePiece(board[rf][ff+s]) ) {
                            callback(board, flags, NormalMove,
                                     rf, ff, rf, ff+s, closure);
@@ -714,7 +776,7 @@ GenPseudoLegal (Board board, int flags, MoveCallback callback, VOIDSTAR closure,
                   }
                   break;
               }
-              if (rf < BOARD_HEIGHT-1 && board[rf + 1][ff] == EmptySquare) {
+              if (rayLength[rf][ff][RAY_N] && board[rf + 1][ff] == EmptySquare) {
 		  callback(board, flags,
 			   rf >= BOARD_HEIGHT-1-promoRank ? WhitePromotion : NormalMove,
 			   rf, ff, rf + 1, ff, closure);
@@ -727,7 +789,7 @@ GenPseudoLegal (Board board, int flags, MoveCallback callback, VOIDSTAR closure,
                                rf, ff, rf+2, ff, closure);
 	      }
 	      for (s = -1; s <= 1; s += 2) {
-                  if (rf < BOARD_HEIGHT-1 && ff + s >= BOARD_LEFT && ff + s < BOARD_RGHT &&
+                  if (rayLength[rf][ff][s < 0 ? RAY_NW : RAY_NE] &&
 		      ((flags & F_KRIEGSPIEL_CAPTURE) ||
 		       BlackPiece(board[rf + 1][ff + s]))) {
 		      callback(board, flags,
@@ -735,7 +797,7 @@ GenPseudoLegal (Board board, int flags, MoveCallback callback, VOIDSTAR closure,
 			       rf, ff, rf + 1, ff + s, closure);
 		  }
 		  if (rf >= BOARD_HEIGHT+1>>1) {// [HGM] grand: 4th & 5th rank on 10-board
-                      if (ff + s >= BOARD_LEFT && ff + s < BOARD_RGHT &&
+                      if (rayLength[rf][ff][s < 0 ? RAY_W : RAY_E] &&
 			  (epfile == ff + s || epfile == EP_UNKNOWN) && rf < BOARD_HEIGHT-3 &&
                           board[rf][ff + s] == BlackPawn &&
                           board[rf+1][ff + s] == EmptySquare) {
@@ -749,14 +811,14 @@ GenPseudoLegal (Board board, int flags, MoveCallback callback, VOIDSTAR closure,
 	    case BlackPawn:
               if(gameInfo.variant == VariantXiangqi) {
                   /* [HGM] capture straight ahead in Xiangqi */
-                  if (rf > 0 && !SameColor(board[rf][ff], board[rf - 1][ff]) ) {
+                  if (rayLength[rf][ff][RAY_S] && !SameColor(board[rf][ff], board[rf - 1][ff]) ) {
                            callback(board, flags, NormalMove,
                                     rf, ff, rf - 1, ff, closure);
                   }
                   /* and move sideways when across the river */
                   for (s = -1; s <= 1; s += 2) {
                       if (rf < BOARD_HEIGHT>>1 &&
-                          ff + s >= BOARD_LEFT && ff + s < BOARD_RGHT &&
+                          rayLength[rf][ff][s < 0 ? RAY_W : RAY_E] &&
                           !BlackPiece(board[rf][ff+s]) ) {
                            callback(board, flags, NormalMove,
                                     rf, ff, rf, ff+s, closure);
@@ -764,7 +826,7 @@ GenPseudoLegal (Board board, int flags, MoveCallback callback, VOIDSTAR closure,
                   }
                   break;
               }
-	      if (rf > 0 && board[rf - 1][ff] == EmptySquare) {
+	      if (rayLength[rf][ff][RAY_S] && board[rf - 1][ff] == EmptySquare) {
 		  callback(board, flags,
 			   rf <= promoRank ? BlackPromotion : NormalMove,
 			   rf, ff, rf - 1, ff, closure);
@@ -777,7 +839,7 @@ GenPseudoLegal (Board board, int flags, MoveCallback callback, VOIDSTAR closure,
 			   rf, ff, rf-2, ff, closure);
 	      }
 	      for (s = -1; s <= 1; s += 2) {
-                  if (rf > 0 && ff + s >= BOARD_LEFT && ff + s < BOARD_RGHT &&
+                  if (rayLength[rf][ff][s < 0 ? RAY_SW : RAY_SE] &&
 		      ((flags & F_KRIEGSPIEL_CAPTURE) ||
 		       WhitePiece(board[rf - 1][ff + s]))) {
 		      callback(board, flags,
@@ -785,7 +847,7 @@ GenPseudoLegal (Board board, int flags, MoveCallback callback, VOIDSTAR closure,
 			       rf, ff, rf - 1, ff + s, closure);
 		  }
 		  if (rf < BOARD_HEIGHT>>1) {
-                      if (ff + s >= BOARD_LEFT && ff + s < BOARD_RGHT &&
+                      if (rayLength[rf][ff][s < 0 ? RAY_W : RAY_E] &&
 			  (epfile == ff + s || epfile == EP_UNKNOWN) && rf > 2 &&
 			  board[rf][ff + s] == WhitePawn &&
 			  board[rf-1][ff + s] == EmptySquare) {
@@ -800,22 +862,12 @@ GenPseudoLegal (Board board, int flags, MoveCallback callback, VOIDSTAR closure,
             case BlackUnicorn:
 	    case WhiteKnight:
 	    case BlackKnight:
-	      for (i = -1; i <= 1; i += 2)
-		for (j = -1; j <= 1; j += 2)
-		  for (s = 1; s <= 2; s++) {
-		      rt = rf + i*s;
-		      ft = ff + j*(3-s);
-                      if (!(rt < 0 || rt >= BOARD_HEIGHT || ft < BOARD_LEFT || ft >= BOARD_RGHT)
-                          && ( gameInfo.variant != VariantXiangqi || board[rf+i*(s-1)][ff+j*(2-s)] == EmptySquare)
-                          && !SameColor(board[rf][ff], board[rt][ft]))
-		      callback(board, flags, NormalMove,
-			       rf, ff, rt, ft, closure);
-		  }
-	      break;
+		Knight(board, flags, rf, ff, callback, closure);
+		break;
 
             case SHOGI WhiteKnight:
 	      for (s = -1; s <= 1; s += 2) {
-                  if (rf < BOARD_HEIGHT-2 && ff + s >= BOARD_LEFT && ff + s < BOARD_RGHT &&
+                  if (jumpLength[rf][ff][JUMP(2, s)] &&
                       !SameColor(board[rf][ff], board[rf + 2][ff + s])) {
                       callback(board, flags, NormalMove,
                                rf, ff, rf + 2, ff + s, closure);
@@ -825,7 +877,7 @@ GenPseudoLegal (Board board, int flags, MoveCallback callback, VOIDSTAR closure,
 
             case SHOGI BlackKnight:
 	      for (s = -1; s <= 1; s += 2) {
-                  if (rf > 1 && ff + s >= BOARD_LEFT && ff + s < BOARD_RGHT &&
+                  if (jumpLength[rf][ff][JUMP(-2, s)] &&
                       !SameColor(board[rf][ff], board[rf - 2][ff + s])) {
                       callback(board, flags, NormalMove,
                                rf, ff, rf - 2, ff + s, closure);
@@ -837,11 +889,11 @@ GenPseudoLegal (Board board, int flags, MoveCallback callback, VOIDSTAR closure,
             case BlackCannon:
               for (d = 0; d <= 1; d++)
                 for (s = -1; s <= 1; s += 2) {
+                  int n = rayLength[rf][ff][d ? (s > 0 ? RAY_N : RAY_S) : (s > 0 ? RAY_E : RAY_W)];
                   m = 0;
-		  for (i = 1;; i++) {
+		  for (i = 1; i <= n; i++) {
 		      rt = rf + (i * s) * d;
 		      ft = ff + (i * s) * (1 - d);
-                      if (rt < 0 || rt >= BOARD_HEIGHT || ft < BOARD_LEFT || ft >= BOARD_RGHT) break;
                       if (m == 0 && board[rt][ft] == EmptySquare)
                                  callback(board, flags, NormalMove,
                                           rf, ff, rt, ft, closure);
@@ -914,14 +966,13 @@ GenPseudoLegal (Board board, int flags, MoveCallback callback, VOIDSTAR closure,
             case SHOGI WhiteMarshall:
             case SHOGI BlackMarshall:
 		Ferz(board, flags, rf, ff, callback, closure);
-		for (d = 0; d <= 1; d++)
-		    for (s = -2; s <= 2; s += 4) {
-			rt = rf + s * d;
-			ft = ff + s * (1 - d);
-			if (rt < 0 || rt >= BOARD_HEIGHT || ft < BOARD_LEFT || ft >= BOARD_RGHT) continue;
-			if (!SameColor(board[rf][ff], board[rt][ft]) )
-			    callback(board, flags, NormalMove, rf, ff, rt, ft, closure);
-		    }
+		for (d = RAY_W; d >= RAY_N; d--) { // Dababba jumps
+		    if (rayLength[rf][ff][d] < 2) continue;
+		    rt = rf + 2*rayStep[d][0];
+		    ft = ff + 2*rayStep[d][1];
+		    if (!SameColor(board[rf][ff], board[rt][ft]) )
+			callback(board, flags, NormalMove, rf, ff, rt, ft, closure);
+		}
 		break;
 
             case SHOGI WhiteAngel:
@@ -931,11 +982,13 @@ GenPseudoLegal (Board board, int flags, MoveCallback callback, VOIDSTAR closure,
             case WhiteAlfil:
             case BlackAlfil:
                 /* [HGM] support Shatranj pieces */
-                for (rs = -1; rs <= 1; rs += 2)
-                  for (fs = -1; fs <= 1; fs += 2) {
+                for (d = RAY_SW; d >= RAY_NE; d--) {
+                      int n = rayLength[rf][ff][d];
+                      rs = rayStep[d][0];
+                      fs = rayStep[d][1];
                       rt = rf + 2 * rs;
                       ft = ff + 2 * fs;
-                      if (!(rt < 0 || rt >= BOARD_HEIGHT || ft < BOARD_LEFT || ft >= BOARD_RGHT)
+                      if (n >= 2
                           && ( gameInfo.variant != VariantXiangqi ||
                                board[rf+rs][ff+fs] == EmptySquare && (2*rf < BOARD_HEIGHT) == (2*rt < BOARD_HEIGHT) )
 
@@ -946,15 +999,14 @@ GenPseudoLegal (Board board, int flags, MoveCallback callback, VOIDSTAR closure,
                          gameInfo.variant == VariantChu      || gameInfo.variant == VariantXiangqi) continue; // classical Alfil
                       rt = rf + rs; // in unknown variant we assume Modern Elephant, which can also do one step
                       ft = ff + fs;
-                      if (!(rt < 0 || rt >= BOARD_HEIGHT || ft < BOARD_LEFT || ft >= BOARD_RGHT)
-                          && !SameColor(board[rf][ff], board[rt][ft]))
+                      if (n >= 1 && !SameColor(board[rf][ff], board[rt][ft]))
                                callback(board, flags, NormalMove,
                                         rf, ff, rt, ft, closure);
 		  }
                 if(gameInfo.variant == VariantSpartan)
                    for(fs = -1; fs <= 1; fs += 2) {
                       ft = ff + fs;
-                      if (!(ft < BOARD_LEFT || ft >= BOARD_RGHT) && board[rf][ft] == EmptySquare)
+                      if (rayLength[rf][ff][fs < 0 ? RAY_W : RAY_E] && board[rf][ft] == EmptySquare)
                                callback(board, flags, NormalMove, rf, ff, rf, ft, closure);
                    }
                 break;
@@ -963,11 +1015,10 @@ GenPseudoLegal (Board board, int flags, MoveCallback callback, VOIDSTAR closure,
 	    case WhiteCardinal:
 	    case BlackCardinal:
               if(gameInfo.variant == VariantChuChess) goto DragonHorse;
-              for (d = 0; d <= 1; d++) // Dababba moves that Rook cannot do
-                for (s = -2; s <= 2; s += 4) {
-		      rt = rf + s * d;
-		      ft = ff + s * (1 - d);
-                      if (rt < 0 || rt >= BOARD_HEIGHT || ft < BOARD_LEFT || ft >= BOARD_RGHT) continue;
+              for (d = RAY_W; d >= RAY_N; d--) { // Dababba moves that Rook cannot do
+                      if (rayLength[rf][ff][d] < 2) continue;
+		      rt = rf + 2*rayStep[d][0];
+		      ft = ff + 2*rayStep[d][1];
 		      if (SameColor(board[rf][ff], board[rt][ft])) continue;
 		      callback(board, flags, NormalMove, rf, ff, rt, ft, closure);
 		  }
@@ -1000,10 +1051,9 @@ GenPseudoLegal (Board board, int flags, MoveCallback callback, VOIDSTAR closure,
             /* Shogi Lance is unlike anything, and asymmetric at that */
             case SHOGI WhiteQueen:
               if(gameInfo.variant == VariantChu) goto doQueen;
-              for(i = 1;; i++) {
+              for(i = 1; i <= rayLength[rf][ff][RAY_N]; i++) {
                       rt = rf + i;
                       ft = ff;
-                      if (rt >= BOARD_HEIGHT) break;
 		      if (SameColor(board[rf][ff], board[rt][ft])) break;
 		      callback(board, flags, NormalMove,
 			       rf, ff, rt, ft, closure);
@@ -1013,10 +1063,9 @@ GenPseudoLegal (Board board, int flags, MoveCallback callback, VOIDSTAR closure,
 
             case SHOGI BlackQueen:
               if(gameInfo.variant == VariantChu) goto doQueen;
-              for(i = 1;; i++) {
+              for(i = 1; i <= rayLength[rf][ff][RAY_S]; i++) {
                       rt = rf - i;
                       ft = ff;
-                      if (rt < 0) break;
 		      if (SameColor(board[rf][ff], board[rt][ft])) break;
 		      callback(board, flags, NormalMove,
 			       rf, ff, rt, ft, closure);
@@ -1028,11 +1077,10 @@ GenPseudoLegal (Board board, int flags, MoveCallback callback, VOIDSTAR closure,
 	    case WhiteDragon:
 	    case BlackDragon:
               if(gameInfo.variant == VariantChuChess) goto DragonKing;
-              for (d = 0; d <= 1; d++) // Dababba moves that Rook cannot do
-                for (s = -2; s <= 2; s += 4) {
-		      rt = rf + s * d;
-		      ft = ff + s * (1 - d);
-                      if (rt < 0 || rt >= BOARD_HEIGHT || ft < BOARD_LEFT || ft >= BOARD_RGHT) continue;
+              for (d = RAY_W; d >= RAY_N; d--) { // Dababba moves that Rook cannot do
+                      if (rayLength[rf][ff][d] < 2) continue;
+		      rt = rf + 2*rayStep[d][0];
+		      ft = ff + 2*rayStep[d][1];
                       if (board[rf+rt>>1][ff+ft>>1] == EmptySquare && gameInfo.variant != VariantSpartan) continue;
 		      if (SameColor(board[rf][ff], board[rt][ft])) continue;
 		      callback(board, flags, NormalMove, rf, ff, rt, ft, closure);
@@ -1126,19 +1174,16 @@ GenPseudoLegal (Board board, int flags, MoveCallback callback, VOIDSTAR closure,
 
 	    case WhiteNightrider:
 	    case BlackNightrider:
-	      for (i = -1; i <= 1; i += 2)
-		for (j = -1; j <= 1; j += 2)
-		  for (s = 1; s <= 2; s++) {  int k;
-                    for(k=1;; k++) {
-		      rt = rf + k*i*s;
-		      ft = ff + k*j*(3-s);
-                      if (rt < 0 || rt >= BOARD_HEIGHT || ft < BOARD_LEFT || ft >= BOARD_RGHT) break;
+	      for (d = 0; d < 8; d++) {
+		for (i = 1; i <= jumpLength[rf][ff][d]; i++) {
+		      rt = rf + i*jumpStep[d][0];
+		      ft = ff + i*jumpStep[d][1];
 		      if (SameColor(board[rf][ff], board[rt][ft])) break;
 		      callback(board, flags, NormalMove,
 			       rf, ff, rt, ft, closure);
 		      if (board[rt][ft] != EmptySquare) break;
-                    }
-		  }
+		}
+	      }
 	      break;
 
 	    Amazon:
@@ -1150,32 +1195,32 @@ GenPseudoLegal (Board board, int flags, MoveCallback callback, VOIDSTAR closure,
 	    // Use Lance as Berolina / Spartan Pawn.
 	    case WhiteLance:
 	      if(gameInfo.variant == VariantSuper) goto Amazon;
-	      if (rf < BOARD_HEIGHT-1 && BlackPiece(board[rf + 1][ff]))
+	      if (rayLength[rf][ff][RAY_N] && BlackPiece(board[rf + 1][ff]))
 		  callback(board, flags,
 			   rf >= BOARD_HEIGHT-1-promoRank ? WhitePromotion : NormalMove,
 			   rf, ff, rf + 1, ff, closure);
 	      for (s = -1; s <= 1; s += 2) {
-	          if (rf < BOARD_HEIGHT-1 && ff + s >= BOARD_LEFT && ff + s < BOARD_RGHT && board[rf + 1][ff + s] == EmptySquare)
+	          if (rayLength[rf][ff][s < 0 ? RAY_NW : RAY_NE] && board[rf + 1][ff + s] == EmptySquare)
 		      callback(board, flags,
 			       rf >= BOARD_HEIGHT-1-promoRank ? WhitePromotion : NormalMove,
 			       rf, ff, rf + 1, ff + s, closure);
-	          if (rf == 1 && ff + 2*s >= BOARD_LEFT && ff + 2*s < BOARD_RGHT && board[3][ff + 2*s] == EmptySquare )
+	          if (rf == 1 && rayLength[rf][ff][s < 0 ? RAY_NW : RAY_NE] >= 2 && board[3][ff + 2*s] == EmptySquare )
 		      callback(board, flags, NormalMove, rf, ff, 3, ff + 2*s, closure);
 	      }
 	      break;
 
 	    case BlackLance:
 	      if(gameInfo.variant == VariantSuper) goto Amazon;
-	      if (rf > 0 && WhitePiece(board[rf - 1][ff]))
+	      if (rayLength[rf][ff][RAY_S] && WhitePiece(board[rf - 1][ff]))
 		  callback(board, flags,
 			   rf <= promoRank ? BlackPromotion : NormalMove,
 			   rf, ff, rf - 1, ff, closure);
 	      for (s = -1; s <= 1; s += 2) {
-	          if (rf > 0 && ff + s >= BOARD_LEFT && ff + s < BOARD_RGHT && board[rf - 1][ff + s] == EmptySquare)
+	          if (rayLength[rf][ff][s < 0 ? RAY_SW : RAY_SE] && board[rf - 1][ff + s] == EmptySquare)
 		      callback(board, flags,
 			       rf <= promoRank ? BlackPromotion : NormalMove,
 			       rf, ff, rf - 1, ff + s, closure);
-	          if (rf == BOARD_HEIGHT-2 && ff + 2*s >= BOARD_LEFT && ff + 2*s < BOARD_RGHT && board[rf-2][ff + 2*s] == EmptySquare )
+	          if (rf == BOARD_HEIGHT-2 && rayLength[rf][ff][s < 0 ? RAY_SW : RAY_SE] >= 2 && board[rf-2][ff + 2*s] == EmptySquare )
 		      callback(board, flags, NormalMove, rf, ff, rf-2, ff + 2*s, closure);
 	      }
             break;
@@ -1186,13 +1231,16 @@ GenPseudoLegal (Board board, int flags, MoveCallback callback, VOIDSTAR closure,
             case SHOGI BlackLion:
             case WhiteLion:
             case BlackLion:
-              for(rt = rf - 2; rt <= rf + 2; rt++) for(ft = ff - 2; ft <= ff + 2; ft++) {
-                if (rt < 0 || rt >= BOARD_HEIGHT || ft < BOARD_LEFT || ft >= BOARD_RGHT) continue;
+              rs = rayLength[rf][ff][RAY_S] < 2 ? rayLength[rf][ff][RAY_S] : 2; // area that lies on the board
+              fs = rayLength[rf][ff][RAY_W] < 2 ? rayLength[rf][ff][RAY_W] : 2;
+              i  = rayLength[rf][ff][RAY_N] < 2 ? rayLength[rf][ff][RAY_N] : 2;
+              j  = rayLength[rf][ff][RAY_E] < 2 ? rayLength[rf][ff][RAY_E] : 2;
+              for(rt = rf - rs; rt <= rf + i; rt++) for(ft = ff - fs; ft <= ff + j; ft++) {
                 if (!(ff == ft && rf == rt) && SameColor(board[rf][ff], board[rt][ft])) continue;
-                i = (killX >= 0 && (rt-killY)*(rt-killY) + (killX-ft)*(killX-ft) < 3); legNr += 2*i;
+                s = (gc->killFile >= 0 && (rt-gc->killRank)*(rt-gc->killRank) + (gc->killFile-ft)*(gc->killFile-ft) < 3); gc->legs += 2*s;
                 callback(board, flags, (rt-rf)*(rt-rf) + (ff-ft)*(ff-ft) < 3 && board[rt][ft] != EmptySquare ? FirstLeg : NormalMove,
                          rf, ff, rt, ft, closure);
-                legNr -= 2*i;
+                gc->legs -= 2*s;
               }
               break;
 
@@ -1248,37 +1296,37 @@ GenPseudoLegal (Board board, int flags, MoveCallback callback, VOIDSTAR closure,
 		break;
 
             case SHOGI WhiteHorned:
-		Sting(board, flags, rf, ff, 1, 0, callback, closure);
+		Sting(gc, board, flags, rf, ff, 1, 0, callback, closure);
 		callback(board, flags, NormalMove, rf, ff, rf, ff, closure);
-		if(killX >= 0) break;
+		if(gc->killFile >= 0) break;
 		Bishop(board, flags, rf, ff, callback, closure);
 		SlideSideways(board, flags, rf, ff, callback, closure);
 		SlideBackward(board, flags, rf, ff, callback, closure);
 		break;
 
             case SHOGI BlackHorned:
-		Sting(board, flags, rf, ff, -1, 0, callback, closure);
+		Sting(gc, board, flags, rf, ff, -1, 0, callback, closure);
 		callback(board, flags, NormalMove, rf, ff, rf, ff, closure);
-		if(killX >= 0) break;
+		if(gc->killFile >= 0) break;
 		Bishop(board, flags, rf, ff, callback, closure);
 		SlideSideways(board, flags, rf, ff, callback, closure);
 		SlideForward(board, flags, rf, ff, callback, closure);
 		break;
 
             case SHOGI WhiteEagle:
-		Sting(board, flags, rf, ff, 1,  1, callback, closure);
-		Sting(board, flags, rf, ff, 1, -1, callback, closure);
+		Sting(gc, board, flags, rf, ff, 1,  1, callback, closure);
+		Sting(gc, board, flags, rf, ff, 1, -1, callback, closure);
 		callback(board, flags, NormalMove, rf, ff, rf, ff, closure);
-		if(killX >= 0) break;
+		if(gc->killFile >= 0) break;
 		Rook(board, flags, rf, ff, callback, closure);
 		SlideDiagBackward(board, flags, rf, ff, callback, closure);
 		break;
 
             case SHOGI BlackEagle:
-		Sting(board, flags, rf, ff, -1,  1, callback, closure);
-		Sting(board, flags, rf, ff, -1, -1, callback, closure);
+		Sting(gc, board, flags, rf, ff, -1,  1, callback, closure);
+		Sting(gc, board, flags, rf, ff, -1, -1, callback, closure);
 		callback(board, flags, NormalMove, rf, ff, rf, ff, closure);
-		if(killX >= 0) break;
+		if(gc->killFile >= 0) break;
 		Rook(board, flags, rf, ff, callback, closure);
 		SlideDiagForward(board, flags, rf, ff, callback, closure);
 		break;
@@ -1316,12 +1364,259 @@ GenPseudoLegal (Board board, int flags, MoveCallback callback, VOIDSTAR closure,
 
 
 typedef struct {
+    MoveGenContext *gc;
     MoveCallback cb;
     VOIDSTAR cl;
 } GenLegalClosure;
 
-int rFilter, fFilter; // [HGM] speed: sorry, but I get a bit tired of this closure madness
-Board xqCheckers, nullBoard;
+Board nullBoard;
+
+/* [HGM] attack: reverse attack test. Rather than generating all moves of the opponent to see if one
+   of those hits the King, we look outward from the King square for pieces that could reach it. This
+   knows the built-in pieces of all variants except Xiangqi and Spartan, and engine-defined pieces whose
+   descriptor only has plain leaps and slides; other piece types that are present (Lion-like pieces,
+   bent or hopping engine-defined moves) still have their moves generated, but only those types.
+   Directions are in the frame of the attacker, so that RAY_N is forward for both colors. */
+
+#define ATT_STEP(d)  (1 << (d))       // step in ray direction d
+#define ATT_SLIDE(d) (0x100 << (d))   // slide in ray direction d
+#define ATT_JUMP(d)  (0x10000 << (d)) // knight jump in jumpStep[] direction d
+#define ATT_NN  0x1000000 // knight ride, all directions
+#define ATT_D   0x2000000 // orthogonal jump to distance 2, all directions
+#define ATT_A   0x4000000 // diagonal jump to distance 2, all directions
+#define ATT_C   0x8000000 // orthogonal hop (Cannon capture)
+#define ATT_ODD -1        // unknown: moves must be generated
+
+#define ATT_W   0x000F    // some common combinations
+#define ATT_F   0x00F0
+#define ATT_R   0x0F00
+#define ATT_B   0xF000
+#define ATT_N   0xFF0000
+#define ATT_V   ATT_STEP(RAY_N)                      // Berolina Pawn, Makruk Man, Shogi Pawn
+#define ATT_P   (ATT_STEP(RAY_NE) | ATT_STEP(RAY_NW)) // Pawn capture
+#define ATT_WS  (ATT_STEP(RAY_E) | ATT_STEP(RAY_W))   // sideways steps
+#define ATT_WV  (ATT_STEP(RAY_N) | ATT_STEP(RAY_S))   // vertical steps
+#define ATT_RS  (ATT_SLIDE(RAY_E) | ATT_SLIDE(RAY_W)) // sideways slides
+#define ATT_RV  (ATT_SLIDE(RAY_N) | ATT_SLIDE(RAY_S)) // vertical slides
+#define ATT_GOLD (ATT_W | ATT_P)
+
+static int rayBack[2][8]  = { { 1, 0, 3, 2, 7, 6, 5, 4 },  // direction a piece on a ray from the King must move
+			      { 0, 1, 3, 2, 5, 4, 7, 6 } }; // to hit it, for white and black attackers
+static int jumpBack[2]    = { 6, 2 }; // the same for knight jumps, to be XORed with the jump direction
+
+static int
+QuickAttacks (MoveGenContext *gc)
+{   // variants in which AttackType() describes all built-in pieces, and check has no special rules
+    VariantClass v = gameInfo.variant;
+    return v != VariantXiangqi && v != VariantSpartan && !gc->quasi && !gc->builtIn;
+}
+
+static ChessSquare
+RoyalType (int flags)
+{
+    if(gameInfo.variant == VariantKnightmate) return flags & F_WHITE_ON_MOVE ? WhiteUnicorn : BlackUnicorn;
+    return flags & F_WHITE_ON_MOVE ? WhiteKing : BlackKing;
+}
+
+static int
+AtomAttacks (BetzaAtom *a, int black)
+{   // how a compiled descriptor captures, as ATT_XXX bits; ATT_ODD if that cannot be described by them,
+    // or if two atoms reach the same square, which would make GenPseudoLegal() count that check twice
+    int att = 0, dababa = 0, alfil = 0, rider = 0;
+    for(; a; a = a->next) {
+	int dir, bit, dx = a->dx, dy = a->dy, dirSet = a->dirSet, ds2 = 0, retry = 0, bits = 0;
+	if(a->leg || a->initial || a->jump != 1 || a->skip) return ATT_ODD; // bent, lame or conditional moves
+	if(a->mode & ~(MODE_HIS | MODE_MINE | 4 | 8)) return ATT_ODD;        // hoppers, castling, cylinder...
+	if(!(a->mode & MODE_HIS)) continue;                                 // cannot capture the King
+	if(a->kingSystem) { // as in MovesFromAtoms() for angle 0
+	    ds2 = dirSet & 0xAA;
+	    if(dirSet &= 0x55) retry = 1, dx = 0; else dx = dy, dirSet = ds2;
+	}
+	if(black) dirSet = (dirSet >> 4 | dirSet << 4) & 255;
+	do {
+	    for(dir=0, bit=1; dir<8; dir++, bit += bit) {
+		int d, vx, vy;
+		if(!(bit & dirSet)) continue;
+		vx = dx*rot[dir][0] + dy*rot[dir][1];
+		vy = dx*rot[dir][2] + dy*rot[dir][3];
+		if(black) vy = -vy; // to frame of the attacker
+		if(!vx && !vy) return ATT_ODD; // null move
+		if(vx*vx + vy*vy <= 2) { // step or slide
+		    for(d=0; rayStep[d][0] != vy || rayStep[d][1] != vx; d++);
+		    if(a->expo > 1) return ATT_ODD;
+		    bits |= a->expo ? ATT_STEP(d) : ATT_SLIDE(d);
+		} else if(vx*vx + vy*vy == 5) { // knight
+		    for(d=0; jumpStep[d][0] != vy || jumpStep[d][1] != vx; d++);
+		    if(a->expo == 1) bits |= ATT_JUMP(d); else if(a->expo == 0) rider |= 1 << d; else return ATT_ODD;
+		} else if(a->expo != 1) return ATT_ODD;
+		else if(vx*vx + vy*vy == 4) dababa |= bit;
+		else if(vx*vx + vy*vy == 8) alfil  |= bit;
+		else return ATT_ODD;
+	    }
+	    dx = dy; dirSet = ds2;
+	} while(retry-- && ds2);
+	if(att & bits) return ATT_ODD;
+	att |= bits;
+    }
+    if(dababa) { if(dababa != 0x55) return ATT_ODD; att |= ATT_D; }
+    if(alfil)  { if(alfil  != 0xAA) return ATT_ODD; att |= ATT_A; }
+    if(rider)  { if(rider  != 0xFF) return ATT_ODD; att |= ATT_NN; }
+    if(att & att >> 8 & 0xFF || (att & ATT_D && att & ATT_R) || (att & ATT_A && att & ATT_B) || (att & ATT_NN && att & ATT_N))
+	return ATT_ODD; // step and slide, or leap and ride, in the same direction
+    return att;
+}
+
+static int
+ShogiAttacks (ChessSquare piece)
+{   // how a (white) piece captures in Shogi and Chu Shogi, as ATT_XXX bits; must match GenPseudoLegal()
+    int chu = gameInfo.variant == VariantChu;
+
+    switch((int)piece) {
+      case WhitePawn:               return ATT_V;
+      case WhiteKnight:             return ATT_JUMP(5) | ATT_JUMP(7);
+      case WhiteBishop:
+      case WhitePBishop:            return ATT_B;
+      case WhiteRook:
+      case WhitePRook:              return ATT_R;
+      case WhiteQueen:              return chu ? ATT_R | ATT_B : ATT_SLIDE(RAY_N);
+      case WhiteMother:             return ATT_R | ATT_B;
+      case WhiteMonarch:
+      case WhiteKing:               return ATT_W | ATT_F;
+      case PROMOTED WhitePawn:      return chu ? ATT_RV : ATT_GOLD;
+      case PROMOTED WhiteKnight:    return chu ? ATT_F | ATT_WS | ATT_STEP(RAY_S) : ATT_GOLD;
+      case WhiteDrunk:
+      case WhiteAlfil:              return ATT_F | ATT_WS | ATT_V;
+      case WhiteStag:               return chu ? ATT_RV | ATT_F | ATT_WS : ATT_ODD; // Shogi uses Black Gold for both
+      case PROMOTED WhiteQueen:
+      case WhiteTokin:
+      case WhiteWazir:              return ATT_GOLD;
+      case WhiteMarshall:           return ATT_F | ATT_D;
+      case WhiteAngel:              return ATT_W | ATT_A | (chu ? 0 : ATT_F);
+      case WhiteCardinal:
+      case WhitePCardinal:          return ATT_B | ATT_W;
+      case WhiteDragon:
+      case WhitePDragon:            return ATT_R | ATT_F;
+      case WhiteFerz:               return ATT_F | ATT_V;
+      case PROMOTED WhiteFerz:      return chu ? ATT_RV | ATT_WS : ATT_GOLD;
+      case WhitePSword:             return ATT_RV | ATT_WS;
+      case WhiteFalcon:
+      case WhitePDagger:            return ATT_RS | ATT_WV;
+      case WhiteCobra:              return ATT_WV;
+      case WhiteUnicorn:            return ATT_F | ATT_WV;
+      case WhiteMan:                return ATT_P | ATT_WV;
+      case WhiteHCrown:             return ATT_B | ATT_RS;
+      case WhiteCrown:              return ATT_B | ATT_RV;
+      case WhiteDolphin:            return ATT_SLIDE(RAY_SE) | ATT_SLIDE(RAY_SW) | ATT_RV;
+      case WhiteHorse:              return ATT_SLIDE(RAY_NE) | ATT_SLIDE(RAY_NW) | ATT_RV;
+      case WhiteLance:              return ATT_SLIDE(RAY_N);
+      case WhiteHorned:             // these have Lion-like moves
+      case WhiteEagle:
+      case WhiteNothing:
+      case WhiteLion:               return ATT_ODD;
+    }
+    return 0; // no moves at all
+}
+
+static int
+AttackType (ChessSquare piece)
+{   // how the piece captures, as ATT_XXX bits; must match GenPseudoLegal() for the QuickAttacks() variants
+    VariantClass v = gameInfo.variant;
+
+    if(PieceToChar(piece) == '~') piece = (ChessSquare) ( DEMOTED piece );
+    if(pieceDefs && pieceDesc[piece]) return pieceAttacks[piece];
+    if(piece >= BlackPawn) piece = (ChessSquare) ( BLACK_TO_WHITE piece );
+    if(IS_SHOGI(v)) return ShogiAttacks(piece);
+
+    switch((int)piece) {
+      case WhitePawn:       return ATT_P;
+      case WhiteUnicorn:
+      case WhiteKnight:     return ATT_N;
+      case WhiteBishop:     return ATT_B;
+      case WhiteRook:       return ATT_R;
+      case WhiteQueen:      return ATT_R | ATT_B;
+      case WhiteKing:       return ATT_W | ATT_F;
+      case WhiteAngel:      return ATT_B | ATT_N;
+      case WhiteMarshall:   return ATT_R | ATT_N;
+      case WhiteSilver:     return ATT_N | ATT_W | ATT_F;
+      case WhiteFerz:       return ATT_F;
+      case WhiteWazir:      return ATT_W;
+      case WhiteAlfil:      return ATT_A | (v == VariantShatranj || v == VariantCourier ? 0 : ATT_F);
+      case WhiteMan:        return v == VariantMakruk || v == VariantASEAN ? ATT_F | ATT_V : ATT_W | ATT_F;
+      case WhiteNightrider: return ATT_NN;
+      case WhiteCardinal:   return ATT_B | ATT_W | (v == VariantChuChess ? 0 : ATT_D);
+      case WhiteDragon:     return ATT_R | (v == VariantChuChess ? ATT_F : ATT_D);
+      case WhiteLance:      return v == VariantSuper ? ATT_R | ATT_B | ATT_N : ATT_V;
+      case WhiteCannon:     return ATT_C;
+      case WhiteFalcon:
+      case WhiteCobra:      return 0; // wildcards do not capture
+    }
+    return ATT_ODD;
+}
+
+static int
+Attacker (ChessSquare piece, int white)
+{   // attack bits of a piece of the given side, 0 for others and for unknown types
+    int att;
+    if(white ? !WhitePiece(piece) : !BlackPiece(piece)) return 0;
+    att = AttackType(piece);
+    return att == ATT_ODD ? 0 : att;
+}
+
+static int
+SquareAttacked (Board board, int r, int f, int white)
+{   // count the pieces of the given side that attack (r,f), by looking outward from it for pieces that can reach it
+    int d, i, rt, ft, att, n = 0, *back = rayBack[!white];
+
+    for(d=0; d<8; d++) { // rays
+	int dr = rayStep[d][0], df = rayStep[d][1], orth = d < 4, screened = FALSE, len = rayLength[r][f][d];
+	for(i=1; i<=len; i++) {
+	    rt = r + i*dr; ft = f + i*df;
+	    if(board[rt][ft] == EmptySquare) continue;
+	    att = Attacker(board[rt][ft], white);
+	    if(screened) { n += (orth && att & ATT_C) != 0; break; } // piece behind the screen can only hop
+	    n += (att & (i == 1 ? ATT_STEP(back[d]) | ATT_SLIDE(back[d]) : ATT_SLIDE(back[d]))) != 0;
+	    screened = TRUE; // first piece on the ray can serve as Cannon screen
+	}
+	if(len >= 2) { // jumps to distance 2; the Dragon only uses those when its Rook move is blocked
+	    att = Attacker(board[r + 2*dr][f + 2*df], white);
+	    if(board[r + dr][f + df] == EmptySquare && att & ATT_SLIDE(back[d])) att = 0; // counted as slider already
+	    n += (att & (orth ? ATT_D : ATT_A)) != 0;
+	}
+    }
+
+    for(d=0; d<8; d++) { // knight jumps and rides
+	for(i=1; i<=jumpLength[r][f][d]; i++) {
+	    rt = r + i*jumpStep[d][0]; ft = f + i*jumpStep[d][1];
+	    if(board[rt][ft] == EmptySquare) continue;
+	    att = Attacker(board[rt][ft], white);
+	    n += (att & (i == 1 ? ATT_JUMP(d ^ jumpBack[!white]) | ATT_NN : ATT_NN)) != 0;
+	    break;
+	}
+    }
+
+    return n;
+}
+
+static int
+FindRoyal (Board board, ChessSquare king, RoyalInfo *ri)
+{   // locate the (first) King, and the opponent piece types that have to be generated; returns the number of Kings
+    int r, f, n = 0;
+    char seen[EmptySquare];
+
+    for(r=0; r<EmptySquare; r++) seen[r] = 0;
+    ri->nOdd = 0;
+    for(f=BOARD_LEFT; f<BOARD_RGHT; f++) for(r=0; r<BOARD_HEIGHT; r++) { // a1, a2, ... as in CheckTest()
+	ChessSquare p = board[r][f];
+	if(p == king) {
+	    if(!n++) ri->rank = r, ri->file = f;
+	} else if((king < BlackPawn ? BlackPiece(p) : WhitePiece(p)) && AttackType(p) == ATT_ODD) {
+	    if(PieceToChar(p) == '~') p = (ChessSquare) ( DEMOTED p ); // as GenPseudoLegal() filters
+	    if(!seen[p]) seen[p] = 1, ri->odd[ri->nOdd++] = p;
+	}
+    }
+    ri->king = king;
+    return n;
+}
 
 extern void GenLegalCallback P((Board board, int flags, ChessMove kind,
 				int rf, int ff, int rt, int ft,
@@ -1331,8 +1626,9 @@ void
 GenLegalCallback (Board board, int flags, ChessMove kind, int rf, int ff, int rt, int ft, VOIDSTAR closure)
 {
     register GenLegalClosure *cl = (GenLegalClosure *) closure;
+    MoveGenContext *gc = cl->gc;
 
-    if(rFilter >= 0 && rFilter != rt || fFilter >= 0 && fFilter != ft) return; // [HGM] speed: ignore moves with wrong to-square
+    if(gc->rFilter >= 0 && gc->rFilter != rt || gc->fFilter >= 0 && gc->fFilter != ft) return; // [HGM] speed: ignore moves with wrong to-square
 
     if (board[EP_STATUS] == EP_IRON_LION && (board[rt][ft] == WhiteLion || board[rt][ft] == BlackLion)) return; //[HGM] lion
 
@@ -1347,7 +1643,7 @@ GenLegalCallback (Board board, int flags, ChessMove kind, int rf, int ff, int rt
 	    else
 		board[rf][ff] = BlackKing; // [HGM] spartan: promote to King before check-test
 	}
-	check = CheckTest(board, flags, rf, ff, rt, ft,
+	check = CheckTestCtx(gc, board, flags, rf, ff, rt, ft,
 		  kind == WhiteCapturesEnPassant ||
 		  kind == BlackCapturesEnPassant);
 	if(promo) board[rf][ff] = BlackLance;
@@ -1378,6 +1674,141 @@ typedef struct {
 } LegalityTestClosure;
 
 
+/* [HGM] cache: the GUI asks for the legal moves of the displayed position over and over
+   (target-square marking, promotion choice, legality test, disambiguation, SAN), often
+   several times per click. So GenLegal remembers the complete list it generated for the
+   last few positions, and replays it for later requests on the same position. The key is
+   the position itself (board copy plus flags and everything else the generator depends on),
+   so that stale lists cannot be hit. Only engine-defined moves are not part of the key;
+   CompilePieceDesc() invalidates the cache when those change. */
+#define CACHE_ENTRIES 4
+#define CACHE_MOVES 1024
+
+typedef struct {
+    signed char rf, ff, rt, ft;
+    char castling; // generated outside GenPseudoLegal, so not subject to its filters
+    int legs;      // legs the generator had set when it produced this move
+    ChessMove kind;
+} CachedMove;
+
+typedef struct {
+    int valid, epoch, flags, killFile, killRank, builtIn, variant, width, height, holdings;
+    Boolean defs;
+    int inCheck, nr;
+    Board board, initial;  // initial position matters for castling and Betza i
+    char toChar[(int)EmptySquare+1]; // promoted/demoted relation
+    CachedMove move[CACHE_MOVES];
+} MoveCache;
+
+typedef struct {
+    MoveGenContext *gc;
+    MoveCache *mc;
+    int castling;
+    MoveCallback cb;
+    VOIDSTAR cl;
+} RecordClosure;
+
+struct MoveCacheSet { // owned by a MoveGenContext, so that generators in different threads do not share it
+    MoveCache entry[CACHE_ENTRIES];
+    int next;
+};
+
+static struct MoveCacheSet guiCache;
+static int cacheEpoch; // entries made before the last change of engine-defined moves are stale
+
+void
+InvalidateMoveCache ()
+{
+    cacheEpoch++;
+}
+
+void
+InitMoveGenContext (MoveGenContext *gc)
+{
+    gc->killFile = gc->killRank = -1;
+    gc->legs = 1;
+    gc->quick = 0;
+    gc->rFilter = gc->fFilter = -1;
+    gc->quasi = gc->royalLion = gc->builtIn = 0;
+    CopyBoard(gc->checkers, nullBoard);
+    gc->royal.board = NULL;
+    gc->cache = (gc == &mainGen ? &guiCache : NULL); // only the GUI context revisits positions
+}
+
+static MoveCache *
+FindCachedMoves (MoveGenContext *gc, Board board, int flags)
+{
+    int i;
+    for(i=0; i<CACHE_ENTRIES; i++) {
+	MoveCache *mc = &gc->cache->entry[i];
+	if(mc->valid && mc->epoch == cacheEpoch && mc->flags == flags && mc->killFile == gc->killFile && mc->killRank == gc->killRank
+	   && mc->builtIn == gc->builtIn && mc->variant == gameInfo.variant && mc->defs == pieceDefs
+	   && mc->width == BOARD_WIDTH && mc->height == BOARD_HEIGHT && mc->holdings == gameInfo.holdingsWidth
+	   && !memcmp(mc->board, board, sizeof(Board)) && !memcmp(mc->toChar, pieceToChar, sizeof(pieceToChar))
+	   && !memcmp(mc->initial, initialPosition, sizeof(Board))) return mc;
+    }
+    return NULL;
+}
+
+static MoveCache *
+NewCachedMoves (MoveGenContext *gc, Board board, int flags)
+{
+    MoveCache *mc = &gc->cache->entry[gc->cache->next++ % CACHE_ENTRIES];
+    mc->valid = FALSE; // until it is complete
+    mc->epoch = cacheEpoch; mc->flags = flags; mc->killFile = gc->killFile; mc->killRank = gc->killRank; mc->builtIn = gc->builtIn;
+    mc->variant = gameInfo.variant; mc->defs = pieceDefs;
+    mc->width = BOARD_WIDTH; mc->height = BOARD_HEIGHT; mc->holdings = gameInfo.holdingsWidth;
+    memcpy(mc->board, board, sizeof(Board));
+    memcpy(mc->initial, initialPosition, sizeof(Board));
+    memcpy(mc->toChar, pieceToChar, sizeof(pieceToChar));
+    mc->nr = 0;
+    return mc;
+}
+
+extern void RecordCallback P((Board board, int flags, ChessMove kind,
+			      int rf, int ff, int rt, int ft,
+			      VOIDSTAR closure));
+
+void
+RecordCallback (Board board, int flags, ChessMove kind, int rf, int ff, int rt, int ft, VOIDSTAR closure)
+{   // pass the move on, and remember it
+    register RecordClosure *cl = (RecordClosure *) closure;
+    MoveCache *mc = cl->mc;
+
+    if(mc->nr < CACHE_MOVES) {
+	CachedMove *m = &mc->move[mc->nr];
+	m->rf = rf; m->ff = ff; m->rt = rt; m->ft = ft;
+	m->kind = kind; m->legs = cl->gc->legs; m->castling = cl->castling;
+    }
+    mc->nr++; // a count beyond capacity keeps the entry from being used
+    cl->cb(board, flags, kind, rf, ff, rt, ft, cl->cl);
+}
+
+static int
+ReplayMoves (MoveGenContext *gc, MoveCache *mc, Board board, int flags, MoveCallback callback, VOIDSTAR closure, ChessSquare filter)
+{   // feed the remembered moves to the callback, filtered as GenLegal would have done
+    int i, saveLegs = gc->legs;
+
+    if(filter == EmptySquare) gc->rFilter = gc->fFilter = -1;
+    for(i=0; i<mc->nr; i++) {
+	CachedMove *m = &mc->move[i];
+	if(!m->castling) {
+	    ChessSquare piece = board[m->rf][m->ff];
+	    if(PieceToChar(piece) == '~') piece = (ChessSquare) ( DEMOTED piece );
+	    if(filter != EmptySquare && piece != filter) continue;
+	    if(gc->rFilter >= 0 && gc->rFilter != m->rt || gc->fFilter >= 0 && gc->fFilter != m->ft) continue;
+	}
+	gc->legs = m->legs;
+	callback(board, flags, m->kind, m->rf, m->ff, m->rt, m->ft, closure);
+    }
+    gc->legs = saveLegs;
+    return mc->inCheck;
+}
+
+static int GenLegalMoves P((MoveGenContext *gc, Board board, int flags, MoveCallback callback,
+			    VOIDSTAR closure, ChessSquare filter, int *castling));
+
+
 /* Like GenPseudoLegal, but (1) include castling moves, (2) unless
    F_IGNORE_CHECK is set in the flags, omit moves that would leave the
    king in check, and (3) if F_ATOMIC_CAPTURE is set in the flags, omit
@@ -1387,19 +1818,52 @@ typedef struct {
    F_IGNORE_CHECK is not set.  [HGM] add castlingRights parameter */
 int
 GenLegal (Board board, int  flags, MoveCallback callback, VOIDSTAR closure, ChessSquare filter)
+{
+    return GenLegalCtx(&mainGen, board, flags, callback, closure, filter);
+}
+
+int
+GenLegalCtx (MoveGenContext *gc, Board board, int  flags, MoveCallback callback, VOIDSTAR closure, ChessSquare filter)
+{
+    MoveCache *mc;
+    RecordClosure rc;
+
+    if(!gc->cache || gc->quasi || gc->quick)
+	return GenLegalMoves(gc, board, flags, callback, closure, filter, NULL);
+    if((mc = FindCachedMoves(gc, board, flags)))
+	return ReplayMoves(gc, mc, board, flags, callback, closure, filter);
+    if(filter != EmptySquare) // a filtered request is cheaper than a full list, and would not fill the cache
+	return GenLegalMoves(gc, board, flags, callback, closure, filter, NULL);
+    rc.gc = gc; rc.mc = mc = NewCachedMoves(gc, board, flags); rc.castling = FALSE;
+    rc.cb = callback; rc.cl = closure;
+    mc->inCheck = GenLegalMoves(gc, board, flags, RecordCallback, (VOIDSTAR) &rc, filter, &rc.castling);
+    mc->valid = mc->nr <= CACHE_MOVES;
+    return mc->inCheck;
+}
+
+static int
+GenLegalMoves (MoveGenContext *gc, Board board, int  flags, MoveCallback callback, VOIDSTAR closure, ChessSquare filter, int *castling)
 {
     GenLegalClosure cl;
     int ff, ft, k, left, right, swap;
     int ignoreCheck = (flags & F_IGNORE_CHECK) != 0;
     ChessSquare wKing = WhiteKing, bKing = BlackKing, *castlingRights = board[CASTLING];
-    int inCheck = !ignoreCheck && CheckTest(board, flags, -1, -1, -1, -1, FALSE); // kludge alert: this would mark pre-existing checkers if status==1
+    RoyalInfo saveRoyal = gc->royal;
+    int inCheck;
     char *p;
 
+    gc->royal.board = NULL; // [HGM] attack: locate King once, for all CheckTest() calls on the moves we generate
+    if(!ignoreCheck && QuickAttacks(gc) && FindRoyal(board, RoyalType(flags), &gc->royal) == 1) gc->royal.board = board[0];
+    inCheck = !ignoreCheck && CheckTestCtx(gc, board, flags, -1, -1, -1, -1, FALSE); // kludge alert: this would mark pre-existing checkers if status==1
+
+    cl.gc = gc;
     cl.cb = callback;
     cl.cl = closure;
-    xqCheckers[EP_STATUS] *= 2; // quasi: if previous CheckTest has been marking, we now set flag for suspending same checkers
-    if(filter == EmptySquare) rFilter = fFilter = -1; // [HGM] speed: do not filter on square if we do not filter on piece
-    GenPseudoLegal(board, flags, GenLegalCallback, (VOIDSTAR) &cl, filter);
+    gc->quasi *= 2; // quasi: if previous CheckTest has been marking, we now set flag for suspending same checkers
+    if(filter == EmptySquare) gc->rFilter = gc->fFilter = -1; // [HGM] speed: do not filter on square if we do not filter on piece
+    GenPseudoLegalCtx(gc, board, flags, GenLegalCallback, (VOIDSTAR) &cl, filter);
+    gc->royal = saveRoyal;
+    if(castling) *castling = TRUE; // for the cache: what follows bypasses the filters
 
     if (inCheck) return TRUE;
 
@@ -1423,10 +1887,10 @@ GenLegal (Board board, int  flags, MoveCallback callback, VOIDSTAR closure, Ches
             castlingRights[0] != NoRights && /* [HGM] check rights */
             ( castlingRights[2] == ff || castlingRights[6] == ff ) &&
             (ignoreCheck ||
-	     (!CheckTest(board, flags, 0, ff, 0, ff + 1, FALSE) &&
-              !CheckTest(board, flags, 0, ff, 0, BOARD_RGHT-3, FALSE) &&
-              (gameInfo.variant != VariantJanus || !CheckTest(board, flags, 0, ff, 0, BOARD_RGHT-2, FALSE)) &&
-	      !CheckTest(board, flags, 0, ff, 0, ff + 2, FALSE)))) {
+	     (!CheckTestCtx(gc, board, flags, 0, ff, 0, ff + 1, FALSE) &&
+              !CheckTestCtx(gc, board, flags, 0, ff, 0, BOARD_RGHT-3, FALSE) &&
+              (gameInfo.variant != VariantJanus || !CheckTestCtx(gc, board, flags, 0, ff, 0, BOARD_RGHT-2, FALSE)) &&
+	      !CheckTestCtx(gc, board, flags, 0, ff, 0, ff + 2, FALSE)))) {
 
 	    callback(board, flags,
                      ff==BOARD_WIDTH>>1 ? WhiteKingSideCastle : WhiteKingSideCastleWild,
@@ -1443,9 +1907,9 @@ GenLegal (Board board, int  flags, MoveCallback callback, VOIDSTAR closure, Ches
             castlingRights[1] != NoRights && /* [HGM] check rights */
             ( castlingRights[2] == ff || castlingRights[6] == ff ) &&
 	    (ignoreCheck ||
-	     (!CheckTest(board, flags, 0, ff, 0, ff - 1, FALSE) &&
-              !CheckTest(board, flags, 0, ff, 0, BOARD_LEFT+3, FALSE) &&
-	      !CheckTest(board, flags, 0, ff, 0, ff - 2, FALSE)))) {
+	     (!CheckTestCtx(gc, board, flags, 0, ff, 0, ff - 1, FALSE) &&
+              !CheckTestCtx(gc, board, flags, 0, ff, 0, BOARD_LEFT+3, FALSE) &&
+	      !CheckTestCtx(gc, board, flags, 0, ff, 0, ff - 2, FALSE)))) {
 
 	    callback(board, flags,
 		     ff==BOARD_WIDTH>>1 ? WhiteQueenSideCastle : WhiteQueenSideCastleWild,
@@ -1462,10 +1926,10 @@ GenLegal (Board board, int  flags, MoveCallback callback, VOIDSTAR closure, Ches
             castlingRights[3] != NoRights && /* [HGM] check rights */
             ( castlingRights[5] == ff || castlingRights[7] == ff ) &&
 	    (ignoreCheck ||
-	     (!CheckTest(board, flags, BOARD_HEIGHT-1, ff, BOARD_HEIGHT-1, ff + 1, FALSE) &&
-              !CheckTest(board, flags, BOARD_HEIGHT-1, ff, BOARD_HEIGHT-1, BOARD_RGHT-3, FALSE) &&
-              (gameInfo.variant != VariantJanus || !CheckTest(board, flags, BOARD_HEIGHT-1, ff, BOARD_HEIGHT-1, BOARD_RGHT-2, FALSE)) &&
-	      !CheckTest(board, flags, BOARD_HEIGHT-1, ff, BOARD_HEIGHT-1, ff + 2, FALSE)))) {
+	     (!CheckTestCtx(gc, board, flags, BOARD_HEIGHT-1, ff, BOARD_HEIGHT-1, ff + 1, FALSE) &&
+              !CheckTestCtx(gc, board, flags, BOARD_HEIGHT-1, ff, BOARD_HEIGHT-1, BOARD_RGHT-3, FALSE) &&
+              (gameInfo.variant != VariantJanus || !CheckTestCtx(gc, board, flags, BOARD_HEIGHT-1, ff, BOARD_HEIGHT-1, BOARD_RGHT-2, FALSE)) &&
+	      !CheckTestCtx(gc, board, flags, BOARD_HEIGHT-1, ff, BOARD_HEIGHT-1, ff + 2, FALSE)))) {
 
 	    callback(board, flags,
 		     ff==BOARD_WIDTH>>1 ? BlackKingSideCastle : BlackKingSideCastleWild,
@@ -1482,9 +1946,9 @@ GenLegal (Board board, int  flags, MoveCallback callback, VOIDSTAR closure, Ches
             castlingRights[4] != NoRights && /* [HGM] check rights */
             ( castlingRights[5] == ff || castlingRights[7] == ff ) &&
 	    (ignoreCheck ||
-	     (!CheckTest(board, flags, BOARD_HEIGHT-1, ff, BOARD_HEIGHT-1, ff - 1, FALSE) &&
-              !CheckTest(board, flags, BOARD_HEIGHT-1, ff, BOARD_HEIGHT-1, BOARD_LEFT+3, FALSE) &&
-              !CheckTest(board, flags, BOARD_HEIGHT-1, ff, BOARD_HEIGHT-1, ff - 2, FALSE)))) {
+	     (!CheckTestCtx(gc, board, flags, BOARD_HEIGHT-1, ff, BOARD_HEIGHT-1, ff - 1, FALSE) &&
+              !CheckTestCtx(gc, board, flags, BOARD_HEIGHT-1, ff, BOARD_HEIGHT-1, BOARD_LEFT+3, FALSE) &&
+              !CheckTestCtx(gc, board, flags, BOARD_HEIGHT-1, ff, BOARD_HEIGHT-1, ff - 2, FALSE)))) {
 
 	    callback(board, flags,
 		     ff==BOARD_WIDTH>>1 ? BlackQueenSideCastle : BlackQueenSideCastleWild,
@@ -1513,7 +1977,7 @@ GenLegal (Board board, int  flags, MoveCallback callback, VOIDSTAR closure, Ches
             for(k=left; k<=right && ft != NoRights; k++) /* first test if blocked */
                 if(k != ft && board[0][k] != EmptySquare) ft = NoRights;
             for(k=left; k<right && ft != NoRights; k++) /* then if not checked */
-                if(!ignoreCheck && CheckTest(board, flags, 0, ff, 0, k, FALSE)) ft = NoRights;
+                if(!ignoreCheck && CheckTestCtx(gc, board, flags, 0, ff, 0, k, FALSE)) ft = NoRights;
             if(ft != NoRights && board[0][ft] == WhiteRook) {
                 if(flags & F_FRC_TYPE_CASTLING) callback(board, flags, WhiteHSideCastleFR, 0, ff, 0, ft, closure);
                 if(swap)                        callback(board, flags, WhiteHSideCastleFR, 0, ft, 0, ff, closure);
@@ -1528,7 +1992,7 @@ GenLegal (Board board, int  flags, MoveCallback callback, VOIDSTAR closure, Ches
             if(ft == 0 && ff != 1 && board[0][1] != EmptySquare) ft = NoRights; /* Rook can be blocked on b1 */
             if(ff > BOARD_LEFT+2)
             for(k=left+1; k<=right && ft != NoRights; k++) /* then if not checked */
-                if(!ignoreCheck && CheckTest(board, flags, 0, ff, 0, k, FALSE)) ft = NoRights;
+                if(!ignoreCheck && CheckTestCtx(gc, board, flags, 0, ff, 0, k, FALSE)) ft = NoRights;
             if(ft != NoRights && board[0][ft] == WhiteRook) {
                 if(flags & F_FRC_TYPE_CASTLING) callback(board, flags, WhiteASideCastleFR, 0, ff, 0, ft, closure);
                 if(swap)                        callback(board, flags, WhiteASideCastleFR, 0, ft, 0, ff, closure);
@@ -1544,7 +2008,7 @@ GenLegal (Board board, int  flags, MoveCallback callback, VOIDSTAR closure, Ches
             for(k=left; k<=right && ft != NoRights; k++) /* first test if blocked */
                 if(k != ft && board[BOARD_HEIGHT-1][k] != EmptySquare) ft = NoRights;
             for(k=left; k<right && ft != NoRights; k++) /* then if not checked */
-                if(!ignoreCheck && CheckTest(board, flags, BOARD_HEIGHT-1, ff, BOARD_HEIGHT-1, k, FALSE)) ft = NoRights;
+                if(!ignoreCheck && CheckTestCtx(gc, board, flags, BOARD_HEIGHT-1, ff, BOARD_HEIGHT-1, k, FALSE)) ft = NoRights;
             if(ft != NoRights && board[BOARD_HEIGHT-1][ft] == BlackRook) {
                 if(flags & F_FRC_TYPE_CASTLING) callback(board, flags, BlackHSideCastleFR, BOARD_HEIGHT-1, ff, BOARD_HEIGHT-1, ft, closure);
                 if(swap)                        callback(board, flags, BlackHSideCastleFR, BOARD_HEIGHT-1, ft, BOARD_HEIGHT-1, ff, closure);
@@ -1559,7 +2023,7 @@ GenLegal (Board board, int  flags, MoveCallback callback, VOIDSTAR closure, Ches
             if(ft == 0 && ff != 1 && board[BOARD_HEIGHT-1][1] != EmptySquare) ft = NoRights; /* Rook can be blocked on b8 */
             if(ff > BOARD_LEFT+2)
             for(k=left+1; k<=right && ft != NoRights; k++) /* then if not checked */
-                if(!ignoreCheck && CheckTest(board, flags, BOARD_HEIGHT-1, ff, BOARD_HEIGHT-1, k, FALSE)) ft = NoRights;
+                if(!ignoreCheck && CheckTestCtx(gc, board, flags, BOARD_HEIGHT-1, ff, BOARD_HEIGHT-1, k, FALSE)) ft = NoRights;
             if(ft != NoRights && board[BOARD_HEIGHT-1][ft] == BlackRook) {
                 if(flags & F_FRC_TYPE_CASTLING) callback(board, flags, BlackASideCastleFR, BOARD_HEIGHT-1, ff, BOARD_HEIGHT-1, ft, closure);
                 if(swap)                        callback(board, flags, BlackASideCastleFR, BOARD_HEIGHT-1, ft, BOARD_HEIGHT-1, ff, closure);
@@ -1574,6 +2038,7 @@ GenLegal (Board board, int  flags, MoveCallback callback, VOIDSTAR closure, Ches
 
 
 typedef struct {
+    MoveGenContext *gc;
     int rking, fking;
     int check;
 } CheckTestClosure;
@@ -1588,13 +2053,14 @@ void
 CheckTestCallback (Board board, int flags, ChessMove kind, int rf, int ff, int rt, int ft, VOIDSTAR closure)
 {
     register CheckTestClosure *cl = (CheckTestClosure *) closure;
+    MoveGenContext *gc = cl->gc;
 
     if (rt == cl->rking && ft == cl->fking) {
-	if(xqCheckers[EP_STATUS] >= 2 && xqCheckers[rf][ff]) return; // checker is piece with suspended checking power
+	if(gc->quasi >= 2 && gc->checkers[rf][ff]) return; // checker is piece with suspended checking power
 	cl->check++;
-	xqCheckers[rf][ff] = xqCheckers[EP_STATUS] & 1; // remember who is checking (if status == 1)
+	gc->checkers[rf][ff] = gc->quasi & 1; // remember who is checking (if quasi == 1)
     }
-    if( board[EP_STATUS] == EP_ROYAL_LION && (board[rt][ft] == WhiteLion || board[rt][ft] == BlackLion)
+    if( gc->royalLion && (board[rt][ft] == WhiteLion || board[rt][ft] == BlackLion)
 	&& (gameInfo.variant != VariantLion || board[rf][ff] != WhiteKing && board[rf][ff] != BlackKing) )
 	cl->check++; // [HGM] lion: forbidden counterstrike against Lion equated to putting yourself in check
 }
@@ -1609,12 +2075,18 @@ CheckTestCallback (Board board, int flags, ChessMove kind, int rf, int ff, int r
    king is in check. */
 int
 CheckTest (Board board, int flags, int rf, int ff, int rt, int ft, int enPassant)
+{
+    return CheckTestCtx(&mainGen, board, flags, rf, ff, rt, ft, enPassant);
+}
+
+int
+CheckTestCtx (MoveGenContext *gc, Board board, int flags, int rf, int ff, int rt, int ft, int enPassant)
 {
     CheckTestClosure cl;
     ChessSquare king = flags & F_WHITE_ON_MOVE ? WhiteKing : BlackKing;
-    ChessSquare captured = EmptySquare, ep=0, trampled=0;
-    int saveKill = killX;
-    /*  Suppress warnings on uninitialized variables    */
+    ChessSquare captured = EmptySquare, trampled=0;
+    int saveKill = gc->killFile, located = (gc->royal.board == board[0]); // GenLegal knows where the King is
+    Board work; // the move is made on a copy, so that the caller's board is never modified
 
     if(gameInfo.variant == VariantXiangqi)
         king = flags & F_WHITE_ON_MOVE ? WhiteWazir : BlackWazir;
@@ -1631,26 +2103,44 @@ CheckTest (Board board, int flags, int rf, int ff, int rt, int ft, int enPassant
 	}
     }
 
+    cl.gc = gc;
     if (rt >= 0) {
+	CopyBoard(work, board); board = work;
 	if (enPassant) {
 	    captured = board[rf][ft];
 	    board[rf][ft] = EmptySquare;
 	} else {
  	    captured = board[rt][ft];
-	    if(killX >= 0) { trampled = board[killY][killX]; board[killY][killX] = EmptySquare; killX = -1; }
+	    if(saveKill >= 0) { trampled = board[gc->killRank][saveKill]; board[gc->killRank][saveKill] = EmptySquare; gc->killFile = -1; }
 	}
 	if(rf == DROP_RANK) board[rt][ft] = ff; else { // [HGM] drop
 	    board[rt][ft] = board[rf][ff];
 	    if(rf != rt || ff != ft) board[rf][ff] = EmptySquare;
 	}
-	ep = board[EP_STATUS];
 	if( captured == WhiteLion || captured == BlackLion ) { // [HGM] lion: Chu Lion-capture rules
-	    ChessSquare victim = killX < 0 ? EmptySquare : trampled;
+	    ChessSquare victim = saveKill < 0 ? EmptySquare : trampled;
 	    if( (board[rt][ft] == WhiteLion || board[rt][ft] == BlackLion) &&           // capturer is Lion
 		(ff - ft > 1 || ft - ff > 1 || rf - rt > 1 || rt - rf > 1) &&           // captures from a distance
 		(victim == EmptySquare || victim == WhitePawn || victim == BlackPawn) ) // no or worthless 'bridge'
-		     board[EP_STATUS] = EP_ROYAL_LION; // on distant Lion x Lion victim must not be pseudo-legally protected
+		     gc->royalLion = TRUE; // on distant Lion x Lion victim must not be pseudo-legally protected
+	}
+    }
+
+    if(QuickAttacks(gc) && !gc->royalLion) { // [HGM] attack: look outward from the King
+	RoyalInfo ri, *rp = &ri;
+	int i;
+	if(located && gc->royal.king == king) {
+	    rp = &gc->royal; cl.rking = rp->rank; cl.fking = rp->file;
+	    if(rt >= 0 && rf == cl.rking && ff == cl.fking) cl.rking = rt, cl.fking = ft; // King moves
+	    if(board[cl.rking][cl.fking] != king) rp = &ri;
 	}
+	if(rp == &gc->royal || FindRoyal(board, king, &ri) == 1) {
+	    if(rp == &ri) cl.rking = ri.rank, cl.fking = ri.file;
+	    cl.check = SquareAttacked(board, cl.rking, cl.fking, king >= BlackPawn);
+	    for(i=0; i<rp->nOdd; i++) // piece types we do not know must generate their moves
+		GenPseudoLegalCtx(gc, board, flags ^ F_WHITE_ON_MOVE, CheckTestCallback, (VOIDSTAR) &cl, rp->odd[i]);
+	    goto undo_move;
+	} // no or several Kings: find the first as always
     }
 
     /* For compatibility with ICS wild 9, we scan the board in the
@@ -1670,7 +2160,7 @@ CheckTest (Board board, int flags, int rf, int ff, int rt, int ft, int enPassant
                       board[i][cl.fking] == (dir>0 ? BlackWazir : WhiteWazir) )
                           cl.check++;
               }
-	      GenPseudoLegal(board, flags ^ F_WHITE_ON_MOVE, CheckTestCallback, (VOIDSTAR) &cl, EmptySquare);
+	      GenPseudoLegalCtx(gc, board, flags ^ F_WHITE_ON_MOVE, CheckTestCallback, (VOIDSTAR) &cl, EmptySquare);
 	      if(gameInfo.variant != VariantSpartan || cl.check == 0) // in Spartan Chess go on to test if other King is checked too
 	         goto undo_move;  /* 2-level break */
 	  }
@@ -1679,16 +2169,8 @@ CheckTest (Board board, int flags, int rf, int ff, int rt, int ft, int enPassant
   undo_move:
 
     if (rt >= 0) {
-	if(rf != DROP_RANK) // [HGM] drop
-	    board[rf][ff] = board[rt][ft];
-	if (enPassant) {
-	    board[rf][ft] = captured;
-	    board[rt][ft] = EmptySquare;
-	} else {
-	    if(saveKill >= 0) board[killY][killX] = trampled, killX = saveKill;
-	    board[rt][ft] = captured;
-	}
-	board[EP_STATUS] = ep;
+	gc->killFile = saveKill;
+	gc->royalLion = FALSE;
     }
 
     return cl.fking < BOARD_RGHT ? cl.check : 1000; // [HGM] atomic: return 1000 if we have no king
@@ -1705,7 +2187,7 @@ HasLion (Board board, int flags)
 }
 
 ChessMove
-LegalDrop (Board board, int flags, ChessSquare piece, int rt, int ft)
+LegalDrop (MoveGenContext *gc, Board board, int flags, ChessSquare piece, int rt, int ft)
 {   // [HGM] put drop legality testing in separate routine for clarity
     int n;
 if(appData.debugMode) fprintf(debugFP, "LegalDrop: %d @ %d,%d)\n", piece, ft, rt);
@@ -1734,7 +2216,7 @@ if(appData.debugMode) fprintf(debugFP, "LegalDrop: %d @ %d,%d)\n", piece, ft, rt
     }
 if(appData.debugMode) fprintf(debugFP, "LegalDrop: %d @ %d,%d)\n", piece, ft, rt);
     if (!(flags & F_IGNORE_CHECK) &&
-	CheckTest(board, flags, DROP_RANK, piece, rt, ft, FALSE) ) return IllegalMove;
+	CheckTestCtx(gc, board, flags, DROP_RANK, piece, rt, ft, FALSE) ) return IllegalMove;
     return flags & F_WHITE_ON_MOVE ? WhiteDrop : BlackDrop;
 }
 
@@ -1755,11 +2237,17 @@ LegalityTestCallback (Board board, int flags, ChessMove kind, int rf, int ff, in
 
 ChessMove
 LegalityTest (Board board, int flags, int rf, int ff, int rt, int ft, int promoChar)
+{
+    return LegalityTestCtx(&mainGen, board, flags, rf, ff, rt, ft, promoChar);
+}
+
+ChessMove
+LegalityTestCtx (MoveGenContext *gc, Board board, int flags, int rf, int ff, int rt, int ft, int promoChar)
 {
     LegalityTestClosure cl; ChessSquare piece, filterPiece;
 
-    if(quickFlag) flags = flags & ~1 | quickFlag & 1; // [HGM] speed: in quick mode quickFlag specifies side-to-move.
-    if(rf == DROP_RANK) return LegalDrop(board, flags, ff, rt, ft);
+    if(gc->quick) flags = flags & ~1 | gc->quick & 1; // [HGM] speed: in quick mode quick specifies side-to-move.
+    if(rf == DROP_RANK) return LegalDrop(gc, board, flags, ff, rt, ft);
     piece = filterPiece = board[rf][ff];
     if(PieceToChar(piece) == '~') filterPiece = DEMOTED piece;
 
@@ -1767,16 +2255,16 @@ LegalityTest (Board board, int flags, int rf, int ff, int rt, int ft, int promoC
     /* (perhaps we should disallow moves that obviously leave us in check?)              */
     if((piece == WhiteFalcon || piece == BlackFalcon ||
         piece == WhiteCobra  || piece == BlackCobra) && gameInfo.variant != VariantChu && !pieceDesc[piece])
-        return CheckTest(board, flags, rf, ff, rt, ft, FALSE) ? IllegalMove : NormalMove;
+        return CheckTestCtx(gc, board, flags, rf, ff, rt, ft, FALSE) ? IllegalMove : NormalMove;
 
     cl.rf = rf;
     cl.ff = ff;
-    cl.rt = rFilter = rt; // [HGM] speed: filter on to-square
-    cl.ft = fFilter = ft;
+    cl.rt = gc->rFilter = rt; // [HGM] speed: filter on to-square
+    cl.ft = gc->fFilter = ft;
     cl.kind = IllegalMove;
     cl.captures = 0; // [HGM] losers: prepare to count legal captures.
     if(flags & F_MANDATORY_CAPTURE) filterPiece = EmptySquare; // [HGM] speed: do not filter in suicide, to find all captures
-    GenLegal(board, flags, LegalityTestCallback, (VOIDSTAR) &cl, filterPiece);
+    GenLegalCtx(gc, board, flags, LegalityTestCallback, (VOIDSTAR) &cl, filterPiece);
     if((flags & F_MANDATORY_CAPTURE) && cl.captures && board[rt][ft] == EmptySquare
 		&& cl.kind != WhiteCapturesEnPassant && cl.kind != BlackCapturesEnPassant)
 	return(IllegalMove); // [HGM] losers: if there are legal captures, non-capts are illegal
@@ -1855,7 +2343,7 @@ if(appData.debugMode)fprintf(debugFP,"SHOGI promoChar = %c\n", promoChar ? promo
                 cl.kind = IllegalMove; // no two Lions
 	    } else if(gameInfo.variant == VariantSpartan && cl.kind == BlackPromotion ) {
 		if(promoChar != PieceToChar(BlackKing)) {
-		    if(CheckTest(board, flags, rf, ff, rt, ft, FALSE)) cl.kind = IllegalMove; // [HGM] spartan: only promotion to King was possible
+		    if(CheckTestCtx(gc, board, flags, rf, ff, rt, ft, FALSE)) cl.kind = IllegalMove; // [HGM] spartan: only promotion to King was possible
 		    if(piece == BlackLance) cl.kind = ImpossibleMove;
 		} else { // promotion to King allowed only if we do not have two yet
 		    int r, f, kings = 0;
@@ -1894,6 +2382,12 @@ MateTestCallback (Board board, int flags, ChessMove kind, int rf, int ff, int rt
 /* Return MT_NONE, MT_CHECK, MT_CHECKMATE, or MT_STALEMATE */
 int
 MateTest (Board board, int flags)
+{
+    return MateTestCtx(&mainGen, board, flags);
+}
+
+int
+MateTestCtx (MoveGenContext *gc, Board board, int flags)
 {
     MateTestClosure cl;
     int inCheck, r, f, myPieces=0, hisPieces=0, nrKing=0;
@@ -1920,7 +2414,7 @@ MateTest (Board board, int flags)
 		if(myPieces == 1) return MT_BARE;
     }
     cl.count = 0;
-    inCheck = GenLegal(board, flags, MateTestCallback, (VOIDSTAR) &cl, EmptySquare);
+    inCheck = GenLegalCtx(gc, board, flags, MateTestCallback, (VOIDSTAR) &cl, EmptySquare);
     // [HGM] 3check: yet to do!
     if (cl.count > 0) {
 	return inCheck ? MT_CHECK : MT_NONE;
@@ -1931,7 +2425,7 @@ MateTest (Board board, int flags)
             for(r=0; r<BOARD_HEIGHT; r++) for(f=BOARD_LEFT; f<BOARD_RGHT; f++) if(board[r][f] == EmptySquare) // all empty squares
                 for(n=0; n<BOARD_HEIGHT; n++) // all pieces in hand
                     if(board[n][holdings] != EmptySquare) {
-                        int moveType = LegalDrop(board, flags, board[n][holdings], r, f);
+                        int moveType = LegalDrop(gc, board, flags, board[n][holdings], r, f);
                         if(moveType == WhiteDrop || moveType == BlackDrop) return (inCheck ? MT_CHECK : MT_NONE); // we have legal drop
                     }
         }
@@ -1990,29 +2484,35 @@ DisambiguateCallback (Board board, int flags, ChessMove kind, int rf, int ff, in
 
 void
 Disambiguate (Board board, int flags, DisambiguateClosure *closure)
+{
+    DisambiguateCtx(&mainGen, board, flags, closure);
+}
+
+void
+DisambiguateCtx (MoveGenContext *gc, Board board, int flags, DisambiguateClosure *closure)
 {
     int illegal = 0; char c = closure->promoCharIn;
 
-    if(quickFlag) flags = flags & ~1 | quickFlag & 1; // [HGM] speed: in quick mode quickFlag specifies side-to-move.
+    if(gc->quick) flags = flags & ~1 | gc->quick & 1; // [HGM] speed: in quick mode quick specifies side-to-move.
     closure->count = closure->captures = 0;
     closure->rf = closure->ff = closure->rt = closure->ft = 0;
     closure->kind = ImpossibleMove;
-    rFilter = closure->rtIn; // [HGM] speed: only consider moves to given to-square
-    fFilter = closure->ftIn;
-    if(quickFlag) { // [HGM] speed: try without check test first, because if that is not ambiguous, we are happy
-        GenLegal(board, flags|F_IGNORE_CHECK, DisambiguateCallback, (VOIDSTAR) closure, closure->pieceIn);
+    gc->rFilter = closure->rtIn; // [HGM] speed: only consider moves to given to-square
+    gc->fFilter = closure->ftIn;
+    if(gc->quick) { // [HGM] speed: try without check test first, because if that is not ambiguous, we are happy
+        GenLegalCtx(gc, board, flags|F_IGNORE_CHECK, DisambiguateCallback, (VOIDSTAR) closure, closure->pieceIn);
         if(closure->count > 1) { // gamble did not pay off. retry with check test to resolve ambiguity
             closure->count = closure->captures = 0;
             closure->rf = closure->ff = closure->rt = closure->ft = 0;
             closure->kind = ImpossibleMove;
-            GenLegal(board, flags, DisambiguateCallback, (VOIDSTAR) closure, closure->pieceIn); // [HGM] speed: only pieces of requested type
+            GenLegalCtx(gc, board, flags, DisambiguateCallback, (VOIDSTAR) closure, closure->pieceIn); // [HGM] speed: only pieces of requested type
         }
     } else
-    GenLegal(board, flags, DisambiguateCallback, (VOIDSTAR) closure, closure->pieceIn); // [HGM] speed: only pieces of requested type
+    GenLegalCtx(gc, board, flags, DisambiguateCallback, (VOIDSTAR) closure, closure->pieceIn); // [HGM] speed: only pieces of requested type
     if (closure->count == 0) {
 	/* See if it's an illegal move due to check */
         illegal = 1;
-        GenLegal(board, flags|F_IGNORE_CHECK, DisambiguateCallback, (VOIDSTAR) closure, closure->pieceIn);
+        GenLegalCtx(gc, board, flags|F_IGNORE_CHECK, DisambiguateCallback, (VOIDSTAR) closure, closure->pieceIn);
 	if (closure->count == 0) {
 	    /* No, it's not even that */
 	  if(!appData.testLegality && closure->pieceIn != EmptySquare) {
@@ -2035,10 +2535,10 @@ Disambiguate (Board board, int flags, DisambiguateClosure *closure)
 	}
     } else if(pieceDefs && closure->count > 1) { // [HGM] gen: move is ambiguous under engine-defined rules
 	DisambiguateClosure spare = *closure;
-	pieceDefs = FALSE; spare.count = 0;     // See if the (erroneous) built-in rules would resolve that
-        GenLegal(board, flags, DisambiguateCallback, (VOIDSTAR) &spare, closure->pieceIn);
+	gc->builtIn = TRUE; spare.count = 0;    // See if the (erroneous) built-in rules would resolve that
+        GenLegalCtx(gc, board, flags, DisambiguateCallback, (VOIDSTAR) &spare, closure->pieceIn);
 	if(spare.count == 1) *closure = spare;  // It does, so use those in stead (game from file saved before gen patch?)
-	pieceDefs = TRUE;
+	gc->builtIn = FALSE;
     }
 
     if (c == 'x') c = NULLCHAR; // get rid of any 'x' (which should never happen?)
@@ -2174,6 +2674,12 @@ CoordsToAlgebraicCallback (Board board, int flags, ChessMove kind, int rf, int f
 */
 ChessMove
 CoordsToAlgebraic (Board board, int flags, int rf, int ff, int rt, int ft, int promoChar, char out[MOVE_LEN])
+{
+    return CoordsToAlgebraicCtx(&mainGen, board, flags, rf, ff, rt, ft, promoChar, out);
+}
+
+ChessMove
+CoordsToAlgebraicCtx (MoveGenContext *gc, Board board, int flags, int rf, int ff, int rt, int ft, int promoChar, char out[MOVE_LEN])
 {
     ChessSquare piece;
     ChessMove kind;
@@ -2200,11 +2706,11 @@ CoordsToAlgebraic (Board board, int flags, int rf, int ff, int rt, int ft, int p
     switch (piece) {
       case WhitePawn:
       case BlackPawn:
-        kind = LegalityTest(board, flags, rf, ff, rt, ft, promoChar);
+        kind = LegalityTestCtx(gc, board, flags, rf, ff, rt, ft, promoChar);
 	if (kind == IllegalMove && !(flags&F_IGNORE_CHECK)) {
 	    /* Keep short notation if move is illegal only because it
                leaves the player in check, but still return IllegalMove */
-            kind = LegalityTest(board, flags|F_IGNORE_CHECK, rf, ff, rt, ft, promoChar);
+            kind = LegalityTestCtx(gc, board, flags|F_IGNORE_CHECK, rf, ff, rt, ft, promoChar);
 	    if (kind == IllegalMove) break;
 	    kind = IllegalMove;
 	}
@@ -2250,7 +2756,7 @@ CoordsToAlgebraic (Board board, int flags, int rf, int ff, int rt, int ft, int p
 	    safeStrCpy(out, "O-O", MOVE_LEN);
 	  else
 	    safeStrCpy(out, "O-O-O", MOVE_LEN);
-	  return LegalityTest(board, flags, rf, ff, rt, ft, promoChar);
+	  return LegalityTestCtx(gc, board, flags, rf, ff, rt, ft, promoChar);
 	}
 	/* End of code added by Tord */
 	/* Test for castling or ICS wild castling */
@@ -2273,7 +2779,7 @@ CoordsToAlgebraic (Board board, int flags, int rf, int ff, int rt, int ft, int p
 	       this situation.  So I am not going to worry about it;
 	       I'll just generate an ambiguous O-O in this case.
 	    */
-            return LegalityTest(board, flags, rf, ff, rt, ft, promoChar);
+            return LegalityTestCtx(gc, board, flags, rf, ff, rt, ft, promoChar);
 	}
 
 	/* else fall through */
@@ -2281,19 +2787,19 @@ CoordsToAlgebraic (Board board, int flags, int rf, int ff, int rt, int ft, int p
 	/* Piece move */
 	cl.rf = rf;
 	cl.ff = ff;
-	cl.rt = rFilter = rt; // [HGM] speed: filter on to-square
-	cl.ft = fFilter = ft;
+	cl.rt = gc->rFilter = rt; // [HGM] speed: filter on to-square
+	cl.ft = gc->fFilter = ft;
 	cl.piece = piece;
 	cl.kind = IllegalMove;
 	cl.rank = cl.file = cl.either = 0;
         c = PieceToChar(piece) ;
-        GenLegal(board, flags, CoordsToAlgebraicCallback, (VOIDSTAR) &cl, c!='~' ? piece : (DEMOTED piece)); // [HGM] speed
+        GenLegalCtx(gc, board, flags, CoordsToAlgebraicCallback, (VOIDSTAR) &cl, c!='~' ? piece : (DEMOTED piece)); // [HGM] speed
 
 	if (cl.kind == IllegalMove && !(flags&F_IGNORE_CHECK)) {
 	    /* Generate pretty moves for moving into check, but
 	       still return IllegalMove.
 	    */
-            GenLegal(board, flags|F_IGNORE_CHECK, CoordsToAlgebraicCallback, (VOIDSTAR) &cl, c!='~' ? piece : (DEMOTED piece));
+            GenLegalCtx(gc, board, flags|F_IGNORE_CHECK, CoordsToAlgebraicCallback, (VOIDSTAR) &cl, c!='~' ? piece : (DEMOTED piece));
 	    if (cl.kind == IllegalMove) break;
 	    cl.kind = IllegalMove;
 	}
@@ -2387,28 +2893,19 @@ CoordsToAlgebraic (Board board, int flags, int rf, int ff, int rt, int ft, int p
 
 // [HGM] XQ: the following code serves to detect perpetual chasing (Asian rules)
 
+typedef struct {
+    unsigned char rf, ff, rt, ft;
+} ChaseMove;
+
 typedef struct {
     /* Input */
     int rf, ff, rt, ft;
     /* Output */
     int recaptures;
+    int chaseStackPointer;
+    ChaseMove chaseStack[100];
 } ChaseClosure;
 
-// I guess the following variables logically belong in the closure too, but I was too lazy and used globals
-
-int preyStackPointer, chaseStackPointer;
-
-struct {
-unsigned char rf, ff, rt, ft;
-} chaseStack[100];
-
-struct {
-unsigned char rank, file;
-} preyStack[100];
-
-
-
-
 // there are three new callbacks for use with GenLegal: for adding captures, deleting them, and finding a recapture
 
 extern void AtacksCallback P((Board board, int flags, ChessMove kind,
@@ -2418,17 +2915,19 @@ extern void AtacksCallback P((Board board, int flags, ChessMove kind,
 void
 AttacksCallback (Board board, int flags, ChessMove kind, int rf, int ff, int rt, int ft, VOIDSTAR closure)
 {   // For adding captures that can lead to chase indictment to the chaseStack
+    register ChaseClosure *cl = (ChaseClosure *) closure;
+
     if(board[rt][ft] == EmptySquare) return;                               // non-capture
     if(board[rt][ft] == WhitePawn && rt <  BOARD_HEIGHT/2) return;         // Pawn before river can be chased
     if(board[rt][ft] == BlackPawn && rt >= BOARD_HEIGHT/2) return;         // Pawn before river can be chased
     if(board[rf][ff] == WhitePawn  || board[rf][ff] == BlackPawn)  return; // Pawns are allowed to chase
     if(board[rf][ff] == WhiteWazir || board[rf][ff] == BlackWazir) return; // King is allowed to chase
     // move cannot be excluded from being a chase trivially (based on attacker and victim); save it on chaseStack
-    chaseStack[chaseStackPointer].rf = rf;
-    chaseStack[chaseStackPointer].ff = ff;
-    chaseStack[chaseStackPointer].rt = rt;
-    chaseStack[chaseStackPointer].ft = ft;
-    chaseStackPointer++;
+    cl->chaseStack[cl->chaseStackPointer].rf = rf;
+    cl->chaseStack[cl->chaseStackPointer].ff = ff;
+    cl->chaseStack[cl->chaseStackPointer].rt = rt;
+    cl->chaseStack[cl->chaseStackPointer].ft = ft;
+    cl->chaseStackPointer++;
 }
 
 extern void ExistingAtacksCallback P((Board board, int flags, ChessMove kind,
@@ -2446,11 +2945,11 @@ ExistingAttacksCallback (Board board, int flags, ChessMove kind, int rf, int ff,
 	rf = cl->rt; ff = cl->ft;      // doctor their fromSquare so they will be recognized in chaseStack
     }
     // search move in chaseStack, and delete it if it occurred there (as we know now it is not a new capture)
-    for(i=0; i<chaseStackPointer; i++) {
-	if(chaseStack[i].rf == rf && chaseStack[i].ff == ff &&
-	   chaseStack[i].rt == rt && chaseStack[i].ft == ft   ) {
+    for(i=0; i<cl->chaseStackPointer; i++) {
+	if(cl->chaseStack[i].rf == rf && cl->chaseStack[i].ff == ff &&
+	   cl->chaseStack[i].rt == rt && cl->chaseStack[i].ft == ft   ) {
 	    // move found on chaseStack, delete it by overwriting with move popped from top of chaseStack
-	    chaseStack[i] = chaseStack[--chaseStackPointer];
+	    cl->chaseStack[i] = cl->chaseStack[--cl->chaseStackPointer];
 	    break;
 	}
     }
@@ -2472,105 +2971,166 @@ ProtectedCallback (Board board, int flags, ChessMove kind, int rf, int ff, int r
 
 extern char moveList[MAX_MOVES][MOVE_LEN];
 
+/* [HGM] XQ: Adjudicate() judges the whole repeat cycle after every move, but what a ply of it
+   did (give check, create chases) only depends on the position and the move played in it.
+   So remember those verdicts per ply, and only analyse the plies that were added since. */
+#define JUDGED_PLIES 256
+
+typedef struct {
+    int ply;              // ply this entry is about
+    int mateStatus;       // MateTest() result of the position, -1 if not yet determined
+    int nrChases;         // number of chases created by the move, -1 if not yet determined
+    char move[MOVE_LEN];  // the move the chases were determined for
+    Board board;          // position before the move
+    ChaseMove chase[100];
+} PlyVerdict;
+
+static PlyVerdict verdicts[JUDGED_PLIES];
+
+static PlyVerdict *
+Verdict (int ply)
+{   // find what we know about this ply; forget it if the position at that ply has changed
+    PlyVerdict *v = &verdicts[ply % JUDGED_PLIES];
+
+    if(v->ply != ply || memcmp(v->board, boards[ply], sizeof(Board))) {
+	v->ply = ply;
+	memcpy(v->board, boards[ply], sizeof(Board));
+	v->mateStatus = v->nrChases = -1;
+    }
+    return v;
+}
+
 int
-PerpetualChase (int first, int last)
-{   // this routine detects if the side to move in the 'first' position is perpetually chasing (when not checking)
-    int i, j, k, tail;
+PlyMateTest (int ply)
+{   // MateTest() on boards[ply], only done once for every position of a game
+    PlyVerdict *v = Verdict(ply);
+
+    if(v->mateStatus < 0) v->mateStatus = MateTest(boards[ply], PosFlags(ply));
+    return v->mateStatus;
+}
+
+static PlyVerdict *
+JudgeChases (MoveGenContext *gc, int i)
+{   // determine which of the captures made possible by move i are chases
+    int j;
     ChaseClosure cl;
     ChessSquare captured;
+    PlyVerdict *v = Verdict(i);
+
+    if(v->nrChases >= 0 && !strcmp(v->move, moveList[i])) return v; // already known
+
+    cl.chaseStackPointer = 0;   // clear stack that is going to hold possible chases
+    // determine all captures possible after the move, and put them on chaseStack
+    GenLegalCtx(gc, boards[i+1], PosFlags(i), AttacksCallback, &cl, EmptySquare);
+    if(appData.debugMode) { int n;
+	for(n=0; n<cl.chaseStackPointer; n++)
+	    fprintf(debugFP, "%c%c%c%c ", cl.chaseStack[n].ff+AAA, cl.chaseStack[n].rf+ONE,
+					  cl.chaseStack[n].ft+AAA, cl.chaseStack[n].rt+ONE);
+	fprintf(debugFP, ": all capts\n");
+    }
+    // determine all captures possible before the move, and delete them from chaseStack
+    cl.rf = moveList[i][1]-ONE; // prepare closure to pass move that led from i to i+1
+    cl.ff = moveList[i][0]-AAA+BOARD_LEFT;
+    cl.rt = moveList[i][3]-ONE;
+    cl.ft = moveList[i][2]-AAA+BOARD_LEFT;
+    CopyBoard(gc->checkers, nullBoard); gc->quasi = 1; // giant kludge to make GenLegal ignore pre-existing checks
+    GenLegalCtx(gc, boards[i],   PosFlags(i), ExistingAttacksCallback, &cl, EmptySquare);
+    gc->quasi = 0; // disable the generation of quasi-legal moves again
+    if(appData.debugMode) { int n;
+	for(n=0; n<cl.chaseStackPointer; n++)
+	    fprintf(debugFP, "%c%c%c%c ", cl.chaseStack[n].ff+AAA, cl.chaseStack[n].rf+ONE,
+					  cl.chaseStack[n].ft+AAA, cl.chaseStack[n].rt+ONE);
+	fprintf(debugFP, ": new capts after %c%c%c%c\n", cl.ff+AAA, cl.rf+ONE, cl.ft+AAA, cl.rt+ONE);
+    }
+    // chaseSack now contains all captures made possible by the move
+    for(j=0; j<cl.chaseStackPointer; j++) { // run through chaseStack to identify true chases
+	int attacker = (int)boards[i+1][cl.chaseStack[j].rf][cl.chaseStack[j].ff];
+	int victim   = (int)boards[i+1][cl.chaseStack[j].rt][cl.chaseStack[j].ft];
+
+	if(attacker >= (int) BlackPawn) attacker = BLACK_TO_WHITE attacker; // convert to white, as piecee type
+	if(victim   >= (int) BlackPawn) victim   = BLACK_TO_WHITE victim;
+
+	if((attacker == WhiteKnight || attacker == WhiteCannon) && victim == WhiteRook)
+	    continue; // C or H attack on R is always chase; leave on chaseStack
+
+	if(attacker == victim) {
+	    if(LegalityTestCtx(gc, boards[i+1], PosFlags(i+1), cl.chaseStack[j].rt,
+	       cl.chaseStack[j].ft, cl.chaseStack[j].rf, cl.chaseStack[j].ff, NULLCHAR) == NormalMove) {
+		    // we can capture back with equal piece, so this is no chase but a sacrifice
+		    cl.chaseStack[j] = cl.chaseStack[--cl.chaseStackPointer]; // delete the capture from the chaseStack
+		    j--; /* ! */ continue;
+	    }
 
-    preyStackPointer = 0;        // clear stack of chased pieces
-    for(i=first; i<last; i+=2) { // for all positions with same side to move
-        if(appData.debugMode) fprintf(debugFP, "judge position %i\n", i);
-	chaseStackPointer = 0;   // clear stack that is going to hold possible chases
-	// determine all captures possible after the move, and put them on chaseStack
-	GenLegal(boards[i+1], PosFlags(i), AttacksCallback, &cl, EmptySquare);
-	if(appData.debugMode) { int n;
-	    for(n=0; n<chaseStackPointer; n++)
-                fprintf(debugFP, "%c%c%c%c ", chaseStack[n].ff+AAA, chaseStack[n].rf+ONE,
-                                              chaseStack[n].ft+AAA, chaseStack[n].rt+ONE);
-            fprintf(debugFP, ": all capts\n");
-	}
-	// determine all captures possible before the move, and delete them from chaseStack
-	cl.rf = moveList[i][1]-ONE; // prepare closure to pass move that led from i to i+1
-	cl.ff = moveList[i][0]-AAA+BOARD_LEFT;
-	cl.rt = moveList[i][3]-ONE;
-	cl.ft = moveList[i][2]-AAA+BOARD_LEFT;
-	CopyBoard(xqCheckers, nullBoard); xqCheckers[EP_STATUS] = 1; // giant kludge to make GenLegal ignore pre-existing checks
-	GenLegal(boards[i],   PosFlags(i), ExistingAttacksCallback, &cl, EmptySquare);
-	xqCheckers[EP_STATUS] = 0; // disable the generation of quasi-legal moves again
-	if(appData.debugMode) { int n;
-	    for(n=0; n<chaseStackPointer; n++)
-                fprintf(debugFP, "%c%c%c%c ", chaseStack[n].ff+AAA, chaseStack[n].rf+ONE,
-                                              chaseStack[n].ft+AAA, chaseStack[n].rt+ONE);
-            fprintf(debugFP, ": new capts after %c%c%c%c\n", cl.ff+AAA, cl.rf+ONE, cl.ft+AAA, cl.rt+ONE);
 	}
-	// chaseSack now contains all captures made possible by the move
-	for(j=0; j<chaseStackPointer; j++) { // run through chaseStack to identify true chases
-            int attacker = (int)boards[i+1][chaseStack[j].rf][chaseStack[j].ff];
-            int victim   = (int)boards[i+1][chaseStack[j].rt][chaseStack[j].ft];
-
-	    if(attacker >= (int) BlackPawn) attacker = BLACK_TO_WHITE attacker; // convert to white, as piecee type
-	    if(victim   >= (int) BlackPawn) victim   = BLACK_TO_WHITE victim;
-
-	    if((attacker == WhiteKnight || attacker == WhiteCannon) && victim == WhiteRook)
-		continue; // C or H attack on R is always chase; leave on chaseStack
-
-	    if(attacker == victim) {
-                if(LegalityTest(boards[i+1], PosFlags(i+1), chaseStack[j].rt,
-                   chaseStack[j].ft, chaseStack[j].rf, chaseStack[j].ff, NULLCHAR) == NormalMove) {
-			// we can capture back with equal piece, so this is no chase but a sacrifice
-                        chaseStack[j] = chaseStack[--chaseStackPointer]; // delete the capture from the chaseStack
-			j--; /* ! */ continue;
-		}
 
-	    }
-
-	    // the attack is on a lower piece, or on a pinned or blocked equal one
-	    CopyBoard(xqCheckers, nullBoard); xqCheckers[EP_STATUS] = 1;
-	    CheckTest(boards[i+1], PosFlags(i+1), -1, -1, -1, -1, FALSE); // if we deliver check with our move, the checkers get marked
-            // test if the victim is protected by a true protector. First make the capture.
-	    captured = boards[i+1][chaseStack[j].rt][chaseStack[j].ft];
-	    boards[i+1][chaseStack[j].rt][chaseStack[j].ft] = boards[i+1][chaseStack[j].rf][chaseStack[j].ff];
-	    boards[i+1][chaseStack[j].rf][chaseStack[j].ff] = EmptySquare;
-	    // Then test if the opponent can recapture
-	    cl.recaptures = 0;         // prepare closure to pass recapture square and count moves to it
-	    cl.rt = chaseStack[j].rt;
-	    cl.ft = chaseStack[j].ft;
-	    if(appData.debugMode) {
-            	fprintf(debugFP, "test if we can recapture %c%c\n", cl.ft+AAA, cl.rt+ONE);
-	    }
-	    xqCheckers[EP_STATUS] = 2; // causes GenLegal to ignore the checks we delivered with the move, in real life evaded before we captured
-            GenLegal(boards[i+1], PosFlags(i+1), ProtectedCallback, &cl, EmptySquare); // try all moves
-	    xqCheckers[EP_STATUS] = 0; // disable quasi-legal moves again
-	    // unmake the capture
-	    boards[i+1][chaseStack[j].rf][chaseStack[j].ff] = boards[i+1][chaseStack[j].rt][chaseStack[j].ft];
-            boards[i+1][chaseStack[j].rt][chaseStack[j].ft] = captured;
-	    // if a recapture was found, piece is protected, and we are not chasing it.
-	    if(cl.recaptures) { // attacked piece was defended by true protector, no chase
-		chaseStack[j] = chaseStack[--chaseStackPointer]; // so delete from chaseStack
-		j--; /* ! */
-	    }
+	// the attack is on a lower piece, or on a pinned or blocked equal one
+	CopyBoard(gc->checkers, nullBoard); gc->quasi = 1;
+	CheckTestCtx(gc, boards[i+1], PosFlags(i+1), -1, -1, -1, -1, FALSE); // if we deliver check with our move, the checkers get marked
+	// test if the victim is protected by a true protector. First make the capture.
+	captured = boards[i+1][cl.chaseStack[j].rt][cl.chaseStack[j].ft];
+	boards[i+1][cl.chaseStack[j].rt][cl.chaseStack[j].ft] = boards[i+1][cl.chaseStack[j].rf][cl.chaseStack[j].ff];
+	boards[i+1][cl.chaseStack[j].rf][cl.chaseStack[j].ff] = EmptySquare;
+	// Then test if the opponent can recapture
+	cl.recaptures = 0;         // prepare closure to pass recapture square and count moves to it
+	cl.rt = cl.chaseStack[j].rt;
+	cl.ft = cl.chaseStack[j].ft;
+	if(appData.debugMode) {
+	    fprintf(debugFP, "test if we can recapture %c%c\n", cl.ft+AAA, cl.rt+ONE);
 	}
-	// chaseStack now contains all moves that chased
-	if(appData.debugMode) { int n;
-	    for(n=0; n<chaseStackPointer; n++)
-                fprintf(debugFP, "%c%c%c%c ", chaseStack[n].ff+AAA, chaseStack[n].rf+ONE,
-                                              chaseStack[n].ft+AAA, chaseStack[n].rt+ONE);
-            fprintf(debugFP, ": chases\n");
+	gc->quasi = 2; // causes GenLegal to ignore the checks we delivered with the move, in real life evaded before we captured
+	GenLegalCtx(gc, boards[i+1], PosFlags(i+1), ProtectedCallback, &cl, EmptySquare); // try all moves
+	gc->quasi = 0; // disable quasi-legal moves again
+	// unmake the capture
+	boards[i+1][cl.chaseStack[j].rf][cl.chaseStack[j].ff] = boards[i+1][cl.chaseStack[j].rt][cl.chaseStack[j].ft];
+	boards[i+1][cl.chaseStack[j].rt][cl.chaseStack[j].ft] = captured;
+	// if a recapture was found, piece is protected, and we are not chasing it.
+	if(cl.recaptures) { // attacked piece was defended by true protector, no chase
+	    cl.chaseStack[j] = cl.chaseStack[--cl.chaseStackPointer]; // so delete from chaseStack
+	    j--; /* ! */
 	}
+    }
+    // chaseStack now contains all moves that chased
+    if(appData.debugMode) { int n;
+	for(n=0; n<cl.chaseStackPointer; n++)
+	    fprintf(debugFP, "%c%c%c%c ", cl.chaseStack[n].ff+AAA, cl.chaseStack[n].rf+ONE,
+					  cl.chaseStack[n].ft+AAA, cl.chaseStack[n].rt+ONE);
+	fprintf(debugFP, ": chases\n");
+    }
+    v->nrChases = cl.chaseStackPointer;
+    for(j=0; j<cl.chaseStackPointer; j++) v->chase[j] = cl.chaseStack[j];
+    safeStrCpy(v->move, moveList[i], MOVE_LEN);
+    return v;
+}
+
+int
+PerpetualChase (int first, int last)
+{   // this routine detects if the side to move in the 'first' position is perpetually chasing (when not checking)
+    int i, j, k, tail;
+    PlyVerdict *v;
+    MoveGenContext gc;          // quasi-legal move generation must not disturb the GUI's generator state
+    int preyStackPointer;
+    struct {
+	unsigned char rank, file;
+    } preyStack[100];
+
+    InitMoveGenContext(&gc);
+
+    preyStackPointer = 0;        // clear stack of chased pieces
+    for(i=first; i<last; i+=2) { // for all positions with same side to move
+        if(appData.debugMode) fprintf(debugFP, "judge position %i\n", i);
+	v = JudgeChases(&gc, i);    // chases made by move i
         if(i == first) { // copy all people chased by first move of repeat cycle to preyStack
-	    for(j=0; j<chaseStackPointer; j++) {
-                preyStack[j].rank = chaseStack[j].rt;
-                preyStack[j].file = chaseStack[j].ft;
+	    for(j=0; j<v->nrChases; j++) {
+                preyStack[j].rank = v->chase[j].rt;
+                preyStack[j].file = v->chase[j].ft;
 	    }
-	    preyStackPointer = chaseStackPointer;
+	    preyStackPointer = v->nrChases;
 	}
 	tail = 0;
-        for(j=0; j<chaseStackPointer; j++) {
+        for(j=0; j<v->nrChases; j++) {
 	    for(k=0; k<preyStackPointer; k++) {
 		// search the victim of each chase move on the preyStack (first occurrence)
-		if(chaseStack[j].ft == preyStack[k].file && chaseStack[j].rt == preyStack[k].rank ) {
+		if(v->chase[j].ft == preyStack[k].file && v->chase[j].rt == preyStack[k].rank ) {
 		    if(k < tail) break; // piece was already identified as still being chased
 		    preyStack[preyStackPointer] = preyStack[tail]; // move chased piece to bottom part of preyStack
 		    preyStack[tail] = preyStack[k];                // by swapping
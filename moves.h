@@ -62,6 +62,9 @@ extern int CompareBoards P((Board board1, Board board2));
 extern char pieceToChar[(int)EmptySquare+1];
 extern char pieceNickName[(int)EmptySquare];
 extern char *pieceDesc[(int)EmptySquare];
+extern void CompilePieceDesc P((ChessSquare piece));
+extern void InvalidateMoveCache P((void));
+extern void MakeRays P((void)); /* [HGM] speed: edge distances for the board size in gameInfo */
 extern Board initialPosition;
 extern Boolean pieceDefs;
 
@@ -69,6 +72,33 @@ typedef void (*MoveCallback) P((Board board, int flags, ChessMove kind,
 				int rf, int ff, int rt, int ft,
 				VOIDSTAR closure));
 
+/* [HGM] gen: everything the move generator remembers between (nested) calls. Each thread that
+   generates moves needs its own context (and its own boards, as CheckTest makes moves on them);
+   the calls without context argument use mainGen, the context of the GUI. */
+typedef struct {
+    ChessSquare *board; /* board GenLegal is working on, NULL if not tracking */
+    ChessSquare king;
+    int rank, file;
+    int nOdd;
+    ChessSquare odd[EmptySquare]; /* opponent piece types that must generate their moves */
+} RoyalInfo;
+
+typedef struct {
+    int killFile, killRank; /* relay square of 2-leg move being entered, killFile < 0 if none */
+    int legs;               /* bits 0 and 1 flag whether the generated move has 1 or 2 legs */
+    int quick;              /* in quick mode: ply + 1, specifies side-to-move */
+    int rFilter, fFilter;   /* to-square GenLegal filters on, -1 if not filtering */
+    int quasi;              /* xiangqi chase: 1 = mark checkers, 2 = suspend checking power of marked ones */
+    int royalLion;          /* [HGM] lion: counter-strike against Lion counts as check */
+    int builtIn;            /* ignore engine-defined moves */
+    Board checkers;         /* pieces marked in quasi mode */
+    RoyalInfo royal;        /* King location, tracked during GenLegal */
+    struct MoveCacheSet *cache; /* move lists GenLegal remembers, NULL if it should not */
+} MoveGenContext;
+
+extern MoveGenContext mainGen;
+extern void InitMoveGenContext P((MoveGenContext *gc));
+
 /* Values for flags arguments */
 #define F_WHITE_ON_MOVE 1
 #define F_WHITE_KCASTLE_OK 2
@@ -112,6 +142,8 @@ typedef void (*MoveCallback) P((Board board, int flags, ChessMove kind,
 */
 extern void GenPseudoLegal P((Board board, int flags,
 			      MoveCallback callback, VOIDSTAR closure, ChessSquare filter));
+extern void GenPseudoLegalCtx P((MoveGenContext *gc, Board board, int flags,
+				 MoveCallback callback, VOIDSTAR closure, ChessSquare filter));
 
 /* Like GenPseudoLegal, but include castling moves and (unless
    F_IGNORE_CHECK is set in the flags) omit moves that would leave the
@@ -121,6 +153,8 @@ extern void GenPseudoLegal P((Board board, int flags,
 */
 extern int GenLegal P((Board board, int flags,
 			MoveCallback callback, VOIDSTAR closure, ChessSquare filter));
+extern int GenLegalCtx P((MoveGenContext *gc, Board board, int flags,
+			   MoveCallback callback, VOIDSTAR closure, ChessSquare filter));
 
 /* If the player on move were to move from (rf, ff) to (rt, ft), would
    he leave himself in check?  Or if rf == -1, is the player on move
@@ -131,6 +165,8 @@ extern int GenLegal P((Board board, int flags,
    king is in check. */
 extern int CheckTest P((Board board, int flags,
 			int rf, int ff, int rt, int ft, int enPassant));
+extern int CheckTestCtx P((MoveGenContext *gc, Board board, int flags,
+			   int rf, int ff, int rt, int ft, int enPassant));
 
 /* Is a move from (rf, ff) to (rt, ft) legal for the player whom the
    flags say is on move?  Other arguments as in GenPseudoLegal.
@@ -138,6 +174,9 @@ extern int CheckTest P((Board board, int flags,
 extern ChessMove LegalityTest P((Board board, int flags,
 				 int rf, int ff, int rt, int ft,
 				 int promoChar));
+extern ChessMove LegalityTestCtx P((MoveGenContext *gc, Board board, int flags,
+				    int rf, int ff, int rt, int ft,
+				    int promoChar));
 
 #define MT_NONE 0
 #define MT_CHECK 1
@@ -152,6 +191,7 @@ extern ChessMove LegalityTest P((Board board, int flags,
 
 /* Return MT_NONE, MT_CHECK, MT_CHECKMATE, or MT_STALEMATE */
 extern int MateTest P((Board board, int flags));
+extern int MateTestCtx P((MoveGenContext *gc, Board board, int flags));
 
 typedef struct {
     /* Input data */
@@ -169,6 +209,7 @@ typedef struct {
 
 /* Disambiguate a partially-known move */
 void Disambiguate P((Board board, int flags, DisambiguateClosure *closure));
+void DisambiguateCtx P((MoveGenContext *gc, Board board, int flags, DisambiguateClosure *closure));
 
 
 /* Convert coordinates to normal algebraic notation.
@@ -177,5 +218,6 @@ void Disambiguate P((Board board, int flags, DisambiguateClosure *closure));
 ChessMove CoordsToAlgebraic P((Board board, int flags,
 			       int rf, int ff, int rt, int ft,
 			       int promoChar, char out[MOVE_LEN]));
-
-extern int quickFlag, killX, killY, legNr;
+ChessMove CoordsToAlgebraicCtx P((MoveGenContext *gc, Board board, int flags,
+				  int rf, int ff, int rt, int ft,
+				  int promoChar, char out[MOVE_LEN]));
@@ -69,13 +69,14 @@ typedef struct {
     short int w, h;
     FILE *fp;
     char *filename;
-    char **strings;
+    ListGame **games; // [HGM] virtual: the games that passed the filter, in order
 } GameListClosure;
 static GameListClosure *glc = NULL;
 
 static char *filterPtr;
 static char *list[1003];
-static int listEnd;
+static char *lines[1000]; // [HGM] virtual: only the lines of the page shown are formatted
+static int listEnd, nLines;
 
 static int GameListPrepare P((int byPos, int narrow));
 static void GameListReplace P((int page));
@@ -163,24 +164,27 @@ GameListPrepare (int byPos, int narrow)
 {   // [HGM] filter: put in separate routine, to make callable from call-back
     int nstrings;
     ListGame *lg;
-    char **st, *line;
+    char *line;
     TimeMark t, t2;
 
     GetTimeMark(&t);
-    if(st = glc->strings) while(*st) free(*st++);
     nstrings = ((ListGame *) gameList.tailPred)->number;
-    glc->strings = (char **) malloc((nstrings + 1) * sizeof(char *));
-    st = glc->strings;
+    free(glc->games); // [HGM] virtual: keep only pointers to the selected games; lines are made when shown
+    glc->games = (ListGame **) malloc((nstrings + 1) * sizeof(ListGame *));
     lg = (ListGame *) gameList.head;
-    listLength = wins = losses = draws = 0;
+    listLength = wins = losses = draws = page = 0; // new selection is shown from its first page
     if(byPos) InitSearch();
     while (nstrings--) {
 	int pos = -1;
 	if(!narrow || lg->position >= 0) { // only consider already selected positions when narrowing
-	  line = GameListLine(lg->number, &lg->gameInfo);
-	  if((filterString[0] == NULLCHAR || SearchPattern( line, filterString )) && (!byPos || (pos=GameContainsPosition(glc->fp, lg)) >= 0) ) {
-            *st++ = line; // [HGM] filter: make adding line conditional.
-	    listLength++;
+	  int match = TRUE;
+	  if(filterString[0] != NULLCHAR && (match = GameListLineMatches(lg, filterString)) < 0) {
+	    line = GameListLine(lg->number, &lg->gameInfo); // pattern too complex for tag columns: try the line
+	    match = SearchPattern( line, filterString );
+	    free(line);
+	  }
+	  if(match && (!byPos || (pos=GameContainsPosition(glc->fp, lg)) >= 0) ) {
+            glc->games[listLength++] = lg; // [HGM] filter: make adding line conditional.
             if( lg->gameInfo.result == WhiteWins ) wins++; else
             if( lg->gameInfo.result == BlackWins ) losses++; else
             if( lg->gameInfo.result == GameIsDrawn ) draws++;
@@ -197,7 +201,7 @@ GameListPrepare (int byPos, int narrow)
     }
     if(appData.debugMode) { GetTimeMark(&t2);printf("GameListPrepare %ld msec\n", SubtractTimeMarks(&t2,&t)); }
     DisplayTitle("XBoard");
-    *st = NULL;
+    glc->games[listLength] = NULL;
     return listLength;
 }
 
@@ -208,8 +212,13 @@ GameListReplace (int page)
   char buf[MSG_SIZ], **st=list;
   int i;
 
+  for(i=0; i<nLines; i++) free(lines[i]);
+  for(nLines=0; nLines<1000 && page+nLines < listLength; nLines++) { // [HGM] virtual: format the page on demand
+    ListGame *lg = glc->games[page+nLines];
+    lines[nLines] = GameListLine(lg->number, &lg->gameInfo);
+  }
   if(page) *st++ = _("previous page"); else if(listLength > 1000) *st++ = "";
-  for(i=0; i<1000; i++) if( !(*st++ = glc->strings[page+i]) ) { st--; break; }
+  for(i=0; i<nLines; i++) *st++ = lines[i];
   listEnd = st - list;
   if(page + 1000 <= listLength) *st++ = _("next page");
   *st = NULL;
@@ -264,14 +273,8 @@ GameListDestroy ()
     if (glc == NULL) return;
     EnableNamedMenuItem("File.SaveSelected", FALSE);
     PopDown(GameListDlg);
-    if (glc->strings != NULL) {
-	char **st;
-	st = glc->strings;
-	while (*st) {
-	    free(*st++);
-	}
-	free(glc->strings);
-    }
+    while (nLines > 0) free(lines[--nLines]);
+    free(glc->games);
     free(glc);
     glc = NULL;
 }
@@ -347,11 +350,15 @@ SetFilter ()
 void
 GameListHighlight (int index)
 {
-    int i=0; char **st;
-    if (!shellUp[GameListDlg]) return;
-    st = list;
-    while(*st && atoi(*st)<index) st++,i++;
-    HighlightWithScroll(&gamesOptions[0], i, listEnd);
+    int lo = 0, hi = listLength;
+    if (!shellUp[GameListDlg] || glc == NULL) return;
+    while(lo < hi) { // [HGM] virtual: bisect the selected games (which are in order) for the first one at or after index
+	int mid = (lo + hi) >> 1;
+	if(glc->games[mid]->number < index) lo = mid + 1; else hi = mid;
+    }
+    if(lo == listLength && lo > 0) lo--;
+    if(lo < page || lo >= page + 1000) GameListReplace(page = lo - lo % 1000); // game is on another page
+    HighlightWithScroll(&gamesOptions[0], lo - page + (page || listLength > 1000), listEnd);
 }
 
 int
@@ -372,10 +379,15 @@ SaveGameListAsText (FILE *f)
 
         for (nItem = 0; nItem < ((ListGame *) gameList.tailPred)->number; nItem++){
             char * st = GameListLineFull(lg->number, &lg->gameInfo);
-	    char *line = GameListLine(lg->number, &lg->gameInfo);
-	    if(filterString[0] == NULLCHAR || SearchPattern( line, filterString ) )
+	    int match = filterString[0] == NULLCHAR || GameListLineMatches(lg, filterString);
+	    if(match < 0) {
+		char *line = GameListLine(lg->number, &lg->gameInfo);
+		match = SearchPattern( line, filterString );
+		free(line);
+	    }
+	    if( match )
 	            fprintf( f, "%s\n", st );
-	    free(st); free(line);
+	    free(st);
             lg = (ListGame *) lg->node.succ;
         }
 
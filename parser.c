@@ -164,7 +164,7 @@ NextUnit (char **p)
 {	// Main parser routine
 	int coord[4], n, result, piece, i;
 	char type[4], promoted, separator, slash, *oldp, *commentEnd, c;
-        int wom = quickFlag ? quickFlag&1 : WhiteOnMove(yyboardindex);
+        int wom = mainGen.quick ? mainGen.quick&1 : WhiteOnMove(yyboardindex);
 
 	// ********* try white first, because it is so common **************************
 	if(**p == ' ' || **p == '\n' || **p == '\t') { parseStart = (*p)++; return Nothing; }
@@ -280,8 +280,8 @@ NextUnit (char **p)
 		currentMoveString[4] = cl.promoCharIn = PromoSuffix(p);
 		currentMoveString[5] = NULLCHAR;
 		if(!cl.promoCharIn && (**p == '-' || **p == 'x')) { // Lion-type multi-leg move
-		    currentMoveString[5] = (killX = toX) + AAA; // what we thought was to-square is in fact kill-square
-		    currentMoveString[6] = (killY = toY) + ONE; // append it as suffix behind long algebraic move
+		    currentMoveString[5] = (mainGen.killFile = toX) + AAA; // what we thought was to-square is in fact kill-square
+		    currentMoveString[6] = (mainGen.killRank = toY) + ONE; // append it as suffix behind long algebraic move
 		    currentMoveString[4] = ';';
 		    currentMoveString[7] = NULLCHAR;
 		    // read new to-square (VERY non-robust! Assumes correct (non-alpha-rank) syntax, and messes up on errors)
@@ -333,7 +333,7 @@ NextUnit (char **p)
 		currentMoveString[0] = cl.ff + AAA;
 		currentMoveString[1] = cl.rf + ONE;
 		currentMoveString[3] = cl.rt + ONE;
-		if(killX < 0) // [HGM] lion: do not overwrite kill-square suffix
+		if(mainGen.killFile < 0) // [HGM] lion: do not overwrite kill-square suffix
 		currentMoveString[4] = cl.promoChar;
 
 		if((cl.kind == WhiteCapturesEnPassant || cl.kind == BlackCapturesEnPassant) && (Match("ep", p) || Match("e.p.", p)));
@@ -643,6 +643,63 @@ OpenLoopback (ProcRef *pr)
     return 0;
 }
 
+/* [HGM] replay: local stand-in for an ICS, which plays back a session recorded with -icsRecord.
+   A forked child writes the recorded chunks into the pipe we read from, with their original
+   timing divided by speed (0 = as fast as we can take them), and swallows everything we send it.
+ */
+int
+OpenReplay (char *file, float speed, ProcRef *pr)
+{
+    int to_prog[2], from_prog[2], pid;
+    ChildProc *cp;
+    FILE *f;
+    struct timeval start;
+
+    if ((f = fopen(file, "rb")) == NULL) return errno;
+
+    SetUpChildIO(to_prog, from_prog);
+
+    gettimeofday(&start, NULL); // back end expects the chunks to arrive relative to its LoadReplaySchedule()
+    if ((pid = fork()) == 0) {
+	/* Child process */
+	char buf[8192], junk[MSG_SIZ];
+	long stamp, delay;
+	int count;
+	struct timeval now, tv;
+	fd_set fds;
+
+	close(to_prog[1]);
+	close(from_prog[0]);
+	while (fscanf(f, "%ld %d", &stamp, &count) == 2 && getc(f) == '\n'
+	       && count > 0 && count <= sizeof(buf) && fread(buf, 1, count, f) == count) {
+	    do { // wait until it is time for this chunk, meanwhile discarding what xboard sends
+		gettimeofday(&now, NULL);
+		delay = speed > 0 ? stamp/speed - (1000*(now.tv_sec - start.tv_sec) + (now.tv_usec - start.tv_usec)/1000) : 0;
+		if (delay < 0) delay = 0;
+		tv.tv_sec = delay / 1000; tv.tv_usec = 1000*(delay % 1000);
+		FD_ZERO(&fds); FD_SET(to_prog[0], &fds);
+		if (select(to_prog[0] + 1, &fds, NULL, NULL, &tv) > 0 && read(to_prog[0], junk, MSG_SIZ) <= 0)
+		    _exit(0); // xboard went away
+	    } while (delay > 0);
+	    if (write(from_prog[1], buf, count) != count) _exit(1);
+	}
+	_exit(0); // end of recording closes the connection; _exit(), so stdio buffers copied from xboard are not flushed twice
+    }
+
+    /* Parent process */
+    fclose(f);
+    close(to_prog[0]);
+    close(from_prog[1]);
+
+    cp = (ChildProc *) calloc(1, sizeof(ChildProc));
+    cp->kind = CPReal;
+    cp->pid = pid;
+    cp->fdFrom = from_prog[0];
+    cp->fdTo = to_prog[1];
+    *pr = (ProcRef) cp;
+    return 0;
+}
+
 int
 OpenRcmd (char *host, char *user, char *cmd, ProcRef *pr)
 {
@@ -694,31 +751,6 @@ OutputToProcess (ProcRef pr, char *message, int count, int *outError)
     return outCount;
 }
 
-/* Output message to process, with "ms" milliseconds of delay
-   between each character. This is needed when sending the logon
-   script to ICC, which for some reason doesn't like the
-   instantaneous send. */
-int
-OutputToProcessDelayed (ProcRef pr, char *message, int count, int *outError, long msdelay)
-{
-    ChildProc *cp = (ChildProc *) pr;
-    int outCount = 0;
-    int r;
-
-    while (count--) {
-	r = write(cp->fdTo, message++, 1);
-	if (r == -1) {
-	    *outError = errno;
-	    return outCount;
-	}
-	++outCount;
-	if (msdelay >= 0)
-	  TimeDelay(msdelay);
-    }
-
-    return outCount;
-}
-
 int
 ICSInitScript ()
 {
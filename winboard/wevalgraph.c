@@ -51,6 +51,9 @@ static COLORREF crBlack = RGB( 0xAD, 0x5D, 0x3D );
 
 static HDC hdcPB = NULL;
 static HBITMAP hbmPB = NULL;
+static HDC hdcCopy = NULL;    // [HGM] incremental: copy of the graph without current-move marker
+static HBITMAP hbmCopy = NULL;
+static int copyWidth, copyHeight;
 static HPEN pens[PEN_ANY+1]; // [HGM] put all pens in one array
 static HBRUSH hbrHist[3] = { NULL, NULL, NULL };
 
@@ -108,6 +111,33 @@ static HBRUSH CreateBrush( UINT style, COLORREF color )
     return CreateBrushIndirect( &stLB );
 }
 
+// front-end: keep a copy of the paint box, from which the back-end can continue painting
+void SaveEvalGraph()
+{
+    if( hbmCopy != NULL && (copyWidth != nWidthPB || copyHeight != nHeightPB) ) {
+        DeleteDC( hdcCopy );
+        DeleteObject( hbmCopy );
+        hbmCopy = NULL;
+    }
+
+    if( hbmCopy == NULL ) {
+        hdcCopy = CreateCompatibleDC( hdcPB );
+        hbmCopy = CreateCompatibleBitmap( hdcPB, copyWidth = nWidthPB, copyHeight = nHeightPB );
+        SelectObject( hdcCopy, hbmCopy );
+    }
+
+    BitBlt( hdcCopy, 0, 0, nWidthPB, nHeightPB, hdcPB, 0, 0, SRCCOPY );
+}
+
+int RestoreEvalGraph()
+{
+    if( hbmCopy == NULL || copyWidth != nWidthPB || copyHeight != nHeightPB ) return FALSE;
+
+    BitBlt( hdcPB, 0, 0, nWidthPB, nHeightPB, hdcCopy, 0, 0, SRCCOPY );
+
+    return TRUE;
+}
+
 // front-end. Create pens, device context and buffer bitmap for global use, copy result to display
 // The back-end part n the middle has been taken out and moed to PainEvalGraph()
 static VOID DisplayEvalGraph( HWND hWnd, HDC hDC )
@@ -94,7 +94,9 @@ int GameListToListBox( HWND hDlg, BOOL boReset, char * pszFilter, struct GameLis
         }
 
       if(!narrow || lg->position >= 0) {
-        if( hasFilter ) {
+        if( hasFilter ) switch( GameListLineMatches(lg, pszFilter) ) { // [HGM] columns: try without making the line
+          case FALSE: skip = TRUE; break;
+          case -1:
             st = GameListLine(lg->number, &lg->gameInfo);
 	    if( !SearchPattern( st, pszFilter) ) skip = TRUE;
         }
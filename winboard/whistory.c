@@ -90,6 +90,15 @@ void ClearHistoryMemo()
     SendDlgItemMessage( moveHistoryDialog, IDC_MoveHistory, WM_SETTEXT, 0, (LPARAM) "" );
 }
 
+// low-level front-end: delete everything from given character position
+void TruncateHistoryMemo( int offset )
+{
+    HWND hMemo = GetDlgItem( moveHistoryDialog, IDC_MoveHistory );
+
+    SendMessage( hMemo, EM_SETSEL, offset, -1 );
+    SendMessage( hMemo, EM_REPLACESEL, FALSE, (LPARAM) "" );
+}
+
 // low-level front-end, made callable from back-end by passing flags and color numbers
 // its task is to append the given text to the text edit
 // the bold argument says 0 = normal, 1 = bold typeface
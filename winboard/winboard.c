@@ -173,6 +173,8 @@ static int logoHeight = 0;
 static char messageText[MESSAGE_TEXT_MAX];
 static int clockTimerEvent = 0;
 static int loadGameTimerEvent = 0;
+static int outputTimerEvent = 0;
+static int engineOutputTimerEvent = 0;
 static int analysisTimerEvent = 0;
 static DelayedEventCallback delayedTimerCallback;
 static int delayedTimerEvent = 0;
@@ -5643,6 +5645,16 @@ WndProc(HWND hwnd, UINT message, WPARAM wParam, LPARAM lParam)
       loadGameTimerEvent = 0;
       AutoPlayGameLoop(); /* call into back end */
       break;
+    case OUTPUT_TIMER_ID:
+      KillTimer(hwnd, outputTimerEvent); /* Simulate one-shot timer as in X*/
+      outputTimerEvent = 0;
+      DrainPacedOutput(); /* call into back end */
+      break;
+    case ENGINE_OUTPUT_TIMER_ID:
+      KillTimer(hwnd, engineOutputTimerEvent); /* Simulate one-shot timer as in X*/
+      engineOutputTimerEvent = 0;
+      FlushEngineOutput(); /* call into back end */
+      break;
     case ANALYSIS_TIMER_ID:
       if ((gameMode == AnalyzeMode || gameMode == AnalyzeFile
                  || appData.icsEngineAnalyze) && appData.periodicUpdates) {
@@ -9004,6 +9016,32 @@ StartLoadGameTimer(long millisec)
 				(UINT) millisec, NULL);
 }
 
+int
+OutputTimerRunning()
+{
+  return outputTimerEvent != 0;
+}
+
+void
+StartOutputTimer(long millisec)
+{
+  outputTimerEvent = SetTimer(hwndMain, (UINT) OUTPUT_TIMER_ID,
+			      (UINT) millisec, NULL);
+}
+
+int
+EngineOutputTimerRunning()
+{
+  return engineOutputTimerEvent != 0;
+}
+
+void
+StartEngineOutputTimer(long millisec)
+{
+  engineOutputTimerEvent = SetTimer(hwndMain, (UINT) ENGINE_OUTPUT_TIMER_ID,
+				    (UINT) millisec, NULL);
+}
+
 void
 AutoSaveGame()
 {
@@ -9490,6 +9528,12 @@ OpenLoopback(ProcRef *pr)
   return NO_ERROR;
 }
 
+int
+OpenReplay(char *file, float speed, ProcRef *pr)
+{
+  return ERROR_CALL_NOT_IMPLEMENTED; /* no replay of ICS sessions on Windows; caller reports it */
+}
+
 
 int
 OpenRcmd(char* host, char* user, char* cmd, ProcRef* pr)
@@ -9850,14 +9894,6 @@ DoSleep(int n)
     if(n != 0) Sleep(n);
 }
 
-int
-OutputToProcessDelayed(ProcRef pr, char *message, int count, int *outError,
-		       long msdelay)
-{
-  /* Ignore delay, not implemented for WinBoard */
-  return OutputToProcess(pr, message, count, outError);
-}
-
 
 void
 CmailSigHandlerCallBack(InputSourceRef isr, VOIDSTAR closure,
@@ -9987,7 +10023,7 @@ AnimateMove(board, fromX, fromY, toX, toY)
   POINT frames[kFactor * 2 + 1];
   int nFrames, n;
 
-  if(killX >= 0 && IS_LION(board[fromY][fromX])) Roar();
+  if(mainGen.killFile >= 0 && IS_LION(board[fromY][fromX])) Roar();
 
   if (!appData.animate) return;
   if (doingSizing) return;
@@ -9995,7 +10031,7 @@ AnimateMove(board, fromX, fromY, toX, toY)
   piece = board[fromY][fromX];
   if (piece >= EmptySquare) return;
 
-  if(killX >= 0) toX = killX, toY = killY; // [HGM] lion: first to kill square
+  if(mainGen.killFile >= 0) toX = mainGen.killFile, toY = mainGen.killRank; // [HGM] lion: first to kill square
 
 again:
 
@@ -1098,6 +1098,11 @@ main (int argc, char **argv)
 	gameInfo.variant = StringToVariant(appData.variant);
 	InitPosition(FALSE);
 
+    if(*appData.diagramFile) { // [HGM] diagram: headless export is only implemented in the GTK build
+	fprintf(stderr, _("%s: -diagramFile is not supported by the Xaw version\n"), programName);
+	exit(1);
+    }
+
     shellWidget =
       XtAppInitialize(&appContext, "XBoard", shellOptions,
 		      XtNumber(shellOptions),
@@ -2253,6 +2258,78 @@ StartLoadGameTimer (long millisec)
 		      (XtPointer) 0);
 }
 
+XtIntervalId outputTimerXID = 0;
+
+int
+OutputTimerRunning ()
+{
+    return outputTimerXID != 0;
+}
+
+void
+OutputTimerCallback (XtPointer arg, XtIntervalId *id)
+{
+    outputTimerXID = 0;
+    DrainPacedOutput();
+}
+
+void
+StartOutputTimer (long millisec)
+{
+    outputTimerXID =
+      XtAppAddTimeOut(appContext, millisec,
+		      (XtTimerCallbackProc) OutputTimerCallback,
+		      (XtPointer) 0);
+}
+
+XtIntervalId animationTimerXID = 0;
+
+int
+AnimationTimerRunning ()
+{
+    return animationTimerXID != 0;
+}
+
+void
+AnimationTimerCallback (XtPointer arg, XtIntervalId *id)
+{
+    animationTimerXID = 0;
+    AnimationTimerEvent();
+}
+
+void
+StartAnimationTimer (long millisec)
+{
+    animationTimerXID =
+      XtAppAddTimeOut(appContext, millisec,
+		      (XtTimerCallbackProc) AnimationTimerCallback,
+		      (XtPointer) 0);
+}
+
+XtIntervalId engineOutputTimerXID = 0;
+
+int
+EngineOutputTimerRunning ()
+{
+    return engineOutputTimerXID != 0;
+}
+
+void
+EngineOutputTimerCallback (XtPointer arg, XtIntervalId *id)
+{
+    engineOutputTimerXID = 0;
+    FlushEngineOutput();
+}
+
+void
+StartEngineOutputTimer (long millisec)
+{
+    engineOutputTimerXID =
+      XtAppAddTimeOut(appContext, millisec,
+		      (XtTimerCallbackProc) EngineOutputTimerCallback,
+		      (XtPointer) 0);
+}
+
 XtIntervalId analysisClockXID = 0;
 
 void
@@ -678,15 +678,23 @@ int
 AppendText (Option *opt, char *s)
 {
     XawTextBlock t;
-    char *v;
     int len;
-    GetWidgetText(opt, &v);
-    len = strlen(v);
+    len = XawTextSourceScan(XawTextGetSource(opt->handle), 0, XawstAll, XawsdRight, 1, True); // end, without copying text
     t.ptr = s; t.firstPos = 0; t.length = strlen(s); t.format = XawFmt8Bit;
     XawTextReplace(opt->handle, len, len, &t);
     return len;
 }
 
+void
+TruncateText (Option *opt, int pos)
+{   // delete everything from given position
+    XawTextBlock t;
+    int len;
+    len = XawTextSourceScan(XawTextGetSource(opt->handle), 0, XawstAll, XawsdRight, 1, True);
+    t.ptr = ""; t.firstPos = 0; t.length = 0; t.format = XawFmt8Bit;
+    if(pos < len) XawTextReplace(opt->handle, pos, len, &t);
+}
+
 void
 SetColor (char *colorName, Option *box)
 {       // sets the color of a widget
@@ -102,6 +102,62 @@ static char zippyOffender[MSG_SIZ]; // [HGM] aborter
 static int zippyConsecGames;
 static time_t zippyLastGameEnd;
 
+/* [HGM] pending: with -zippyMaxPending, challenges arriving while Zippy plays, or while its engine
+   is still busy with the previous game, are held rather than declined, and accepted in order of
+   arrival once the engine is free. Chatter during a game is held too, so that the lines file
+   is not read while moves have to go out. */
+#define MAX_PENDING 16
+#define MAX_DEFERRED 8
+
+typedef struct {
+    char rated[16], wild[64], base[16], increment[16], opponent[64];
+} PendingChallenge;
+
+static PendingChallenge zippyPending[MAX_PENDING];
+static int nrPending;
+static char deferredHow[MAX_DEFERRED][64], deferredWhom[MAX_DEFERRED][64];
+static int nrDeferred;
+
+static int
+ZippyBusy ()
+{
+    return gameMode == IcsPlayingWhite || gameMode == IcsPlayingBlack ||
+	   !first.initDone || first.lastPing != first.lastPong;
+}
+
+static int
+HoldChallenge (char *srated, char *swild, char *sbase, char *sincrement, char *opponent)
+{
+    PendingChallenge *c;
+    int i;
+
+    for (i = 0; i < nrPending; i++) /* renewed challenge keeps its place in line */
+	if (StrCaseCmp(zippyPending[i].opponent, opponent) == 0) break;
+    if (i == nrPending) {
+	if (nrPending >= appData.zippyMaxPending || nrPending >= MAX_PENDING) return FALSE;
+	nrPending++;
+    }
+    c = &zippyPending[i];
+    safeStrCpy(c->rated, srated, sizeof(c->rated));
+    safeStrCpy(c->wild, swild, sizeof(c->wild));
+    safeStrCpy(c->base, sbase, sizeof(c->base));
+    safeStrCpy(c->increment, sincrement, sizeof(c->increment));
+    safeStrCpy(c->opponent, opponent, sizeof(c->opponent));
+    return TRUE;
+}
+
+static void
+DropPending (char *opponent)
+{
+    int i;
+
+    for (i = 0; i < nrPending; i++)
+	if (StrCaseCmp(zippyPending[i].opponent, opponent) == 0) {
+	    memmove(zippyPending + i, zippyPending + i + 1, (--nrPending - i) * sizeof(PendingChallenge));
+	    return;
+	}
+}
+
 extern void mysrandom(unsigned int seed);
 extern int myrandom(void);
 
@@ -305,16 +361,86 @@ char *swifties[] = {
 
 #define MAX_SPEECH 250
 
+/* The lines file is read into memory once, cleaned up, and indexed by saying,
+   so that picking one is a single random number. It is read again only when
+   its modification time changes.
+ */
+static char *zippyText;       /* all usable sayings, each NUL-terminated */
+static char **zippyLine;      /* start of each saying in zippyText */
+static int nrZippyLines;
+static time_t zippyLinesTime;
+
+static int
+IndexZippyLines ()
+{
+    struct stat st;
+    FILE *f;
+    char *text, **index, *p, *q, *start;
+    int n, c, size;
+
+    if (stat(appData.zippyLines, &st) == 0 && zippyText != NULL &&
+	st.st_mtime == zippyLinesTime) return nrZippyLines;
+    f = fopen(appData.zippyLines, "r");
+    if (f == NULL) {
+	if (zippyText != NULL) return nrZippyLines; /* keep what we have */
+	DisplayFatalError("Can't open Zippy lines file", errno, 1);
+	return 0;
+    }
+    fstat(fileno(f), &st);
+    size = st.st_size;
+    text = (char *) malloc(size + 1);
+    size = fread(text, 1, size, f);
+    fclose(f);
+    text[size] = NULLCHAR;
+
+    /* Text before the first separator is a comment, and so is text after
+       the last one; sayings are compacted to one line in place. */
+    for (n = 0, p = text; p < text + size; p++) if (*p == '^' || *p == NULLCHAR) n++;
+    index = (char **) malloc((n + 1) * sizeof(char *));
+    for (p = text; p < text + size && *p != '^' && *p != NULLCHAR; p++);
+    n = 0;
+    while (p < text + size) {
+	p++;
+	while (*p == '\n' || *p == '\r') p++;
+	start = q = p;
+	while (p < text + size && *p != '^' && *p != NULLCHAR) {
+	    c = *p++;
+	    if (c == '\n' || c == '\r') {
+		c = ' ';
+		while (*p == ' ' || *p == '\n' || *p == '\r') p++;
+	    } else if (c == '\t' || (unsigned char) c < ' ') c = ' ';
+	    *q++ = c;
+	}
+	if (p >= text + size) break; /* unterminated */
+	while (q > start && q[-1] == ' ') q--;
+	*q = NULLCHAR;
+	if (q > start && q - start < MAX_SPEECH) index[n++] = start;
+    }
+
+    free(zippyText); free(zippyLine);
+    zippyText = text; zippyLine = index; nrZippyLines = n;
+    zippyLinesTime = st.st_mtime;
+    return n;
+}
+
 void
 Speak (char *how, char *whom)
 {
-    static FILE *zipfile = NULL;
-    static struct stat zipstat;
-    char zipbuf[MAX_SPEECH + 1];
+    char zipbuf[MAX_SPEECH + 2];
     static time_t lastShout = 0;
     time_t now;
-    char  *p;
-    int c, speechlen;
+    int tries;
+
+    if (appData.zippyMaxPending > 0 &&
+	(gameMode == IcsPlayingWhite || gameMode == IcsPlayingBlack)) {
+	/* [HGM] pending: say it after the game; kibitzes and whispers only make sense during it */
+	if (strcmp(how, "kibitz") && strcmp(how, "whisper") && nrDeferred < MAX_DEFERRED) {
+	    safeStrCpy(deferredHow[nrDeferred], how, sizeof(deferredHow[0]));
+	    safeStrCpy(deferredWhom[nrDeferred], whom ? whom : "", sizeof(deferredWhom[0]));
+	    nrDeferred++;
+	}
+	return;
+    }
 
     if (strcmp(how, "shout") == 0) {
 	now = time((time_t *) NULL);
@@ -326,58 +452,19 @@ Speak (char *how, char *whom)
 	}
     }
 
-    if (zipfile == NULL) {
-	zipfile = fopen(appData.zippyLines, "r");
-	if (zipfile == NULL) {
-	    DisplayFatalError("Can't open Zippy lines file", errno, 1);
-	    return;
-	}
-	fstat(fileno(zipfile), &zipstat);
-    }
-
-    for (;;) {
-	fseek(zipfile, (unsigned) random() % zipstat.st_size, 0);
-	do {
-	  c = getc(zipfile);
-	} while (c != NULLCHAR && c != '^' && c != EOF);
-	if (c == EOF) continue;
-	while ((c = getc(zipfile)) == '\n') ;
-	if (c == EOF) continue;
-	break;
-    }
+    if (IndexZippyLines() == 0) return;
 
     /* Don't use ics_prefix; we need to let FICS expand the alias i -> it,
        but use the real command "i" on ICC */
-    safeStrCpy(zipbuf, how, sizeof(zipbuf)/sizeof(zipbuf[0]));
-    strcat(zipbuf, " ");
-    if (whom != NULL) {
-	strcat(zipbuf, whom);
-	strcat(zipbuf, " ");
-    }
-    speechlen = strlen(zipbuf);
-    p = zipbuf + speechlen;
-
-    while (++speechlen < MAX_SPEECH) {
-	if (c == NULLCHAR || c == '^') {
-	    *p++ = '\n';
-	    *p = '\0';
+    for (tries = 0; tries < 10; tries++) {
+	char *line = zippyLine[(unsigned) random() % nrZippyLines];
+	if (snprintf(zipbuf, sizeof(zipbuf), "%s %s%s%s\n", how,
+		     whom ? whom : "", whom ? " " : "", line) < sizeof(zipbuf) - 1) {
 	    SendToICS(zipbuf);
 	    return;
-	} else if (c == '\n') {
-	    *p++ = ' ';
-	    do {
-		c = getc(zipfile);
-	    } while (c == ' ');
-	} else if (c == EOF) {
-	    break;
-	} else {
-	    *p++ = c;
-	    c = getc(zipfile);
 	}
+	/* Too long with this prefix.  Try something else. */
     }
-    /* Tried to say something too long, or junk at the end of the
-       file.  Try something else. */
-    Speak(how, whom);  /* tail recursion */
 }
 
 int
@@ -741,6 +828,9 @@ ZippyGameStart (char *white, char* black)
       return;
     }
 
+    DropPending(white); /* [HGM] pending: opponent got the game some other way */
+    DropPending(black);
+
     if (appData.zippyGameStart[0] != NULLCHAR) {
       SendToICS(appData.zippyGameStart);
       SendToICS("\n");
@@ -834,6 +924,18 @@ ZippyHandleChallenge (char *srated, char *swild, char *sbase, char *sincrement,
       return;
     }
 
+    /* Playing, or engine not ready?  Hold the challenge, if there is room. */
+    if (appData.zippyMaxPending > 0 && ZippyBusy()) {
+      if (HoldChallenge(srated, swild, sbase, sincrement, opponent))
+	snprintf(buf, MSG_SIZ, "%stell %s I'm busy right now; I will accept your challenge as soon as I am free.\n",
+		ics_prefix, opponent);
+      else
+	snprintf(buf, MSG_SIZ, "%stell %s Sorry, I'm busy and too many challenges are waiting already; try again later.\n%sdecline %s\n",
+		ics_prefix, opponent, ics_prefix, opponent);
+      SendToICS(buf);
+      return;
+    }
+
     /* Engine not yet initialized or still thinking about last game? */
     if (!first.initDone || first.lastPing != first.lastPong) {
       snprintf(buf, MSG_SIZ,  "%stell %s I'm not quite ready for a new game yet; try again soon.\n%sdecline %s\n",
@@ -850,6 +952,27 @@ ZippyHandleChallenge (char *srated, char *swild, char *sbase, char *sincrement,
 }
 
 
+/* Called when the engine may have become free: say what was held during
+   the game, and take on the oldest held challenge.
+ */
+void
+ZippyEngineReady ()
+{
+    PendingChallenge c;
+    int i, n = nrDeferred;
+
+    if (gameMode == IcsPlayingWhite || gameMode == IcsPlayingBlack) return;
+    nrDeferred = 0;
+    for (i = 0; i < n; i++)
+	Speak(deferredHow[i], deferredWhom[i][0] ? deferredWhom[i] : NULL);
+
+    if (nrPending == 0 || ZippyBusy()) return;
+    c = zippyPending[0];
+    DropPending(c.opponent);
+    ZippyHandleChallenge(c.rated, c.wild, c.base, c.increment, c.opponent);
+}
+
+
 /* Accept matches */
 int
 ZippyMatch (char *buf, int *i)
@@ -924,6 +1047,12 @@ ZippyMatch (char *buf, int *i)
     }
 
 
+    if (looking_at(buf, i, "* withdraws the match offer") ||
+	looking_at(buf, i, "Challenge from * removed")) {
+	DropPending(StripHighlightAndTitle(star_match[0])); // [HGM] pending
+	return TRUE;
+    }
+
         if (looking_at(buf, i, "Your opponent offers you a draw") ||
             looking_at(buf, i, "* offers you a draw")) {
             if (first.sendDrawOffers && first.initDone) {
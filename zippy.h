@@ -58,5 +58,6 @@ void ZippyGameStart P((char *white, char *black));
 int ZippyMatch P((char *buf, int *i));
 void ZippyFirstBoard P((int moveNum, int basetime, int increment));
 void ZippyGameEnd P((ChessMove result, char *resultDetails));
+void ZippyEngineReady P((void));
 void ZippyHoldings P((char *white_holding, char *black_holding,
 		      char *new_piece));